@@ -22,7 +22,8 @@ LightProbe::~LightProbe()
 }
 
 bool LightProbe::Init(CommandList* pCommandList, const DescriptorTableLib::sptr& descriptorTableLib,
-	vector<Resource::uptr>& uploaders, const wstring pFileNames[], uint32_t numFiles)
+	vector<Resource::uptr>& uploaders, const wstring pFileNames[], uint32_t numFiles,
+	SHMode shMode)
 {
 	const auto pDevice = pCommandList->GetDevice();
 	m_graphicsPipelineLib = Graphics::PipelineLib::MakeUnique(pDevice);
@@ -75,6 +76,35 @@ bool LightProbe::Init(CommandList* pCommandList, const DescriptorTableLib::sptr&
 		ResourceFlag::ALLOW_UNORDERED_ACCESS, MemoryType::DEFAULT,
 		1, nullptr, 1, nullptr, MemoryFlag::NONE, L"SHWeights1"), false);
 
+	// SH projection is linear, so lerping the coefficients of the sources equals projecting
+	// the lerped radiance, and the sum of cached partial sums equals a full projection
+	m_shMode = shMode;
+	m_inputProbeIdx = 0;
+	m_blend = 0.0f;
+	m_isSourceSHCached = false;
+	m_dirtyTiles = ~0ull;
+	if (m_shMode == SH_MODE_BLEND_CACHED)
+	{
+		m_coeffSources = StructuredBuffer::MakeUnique();
+		XUSG_N_RETURN(m_coeffSources->Create(pDevice, SH_MAX_ORDER * SH_MAX_ORDER * numFiles, sizeof(float[3]),
+			ResourceFlag::NONE, MemoryType::DEFAULT, 1, nullptr, 1, nullptr, MemoryFlag::NONE,
+			L"SHSourceCoefficients"), false);
+	}
+	else if (m_shMode == SH_MODE_INCREMENTAL)
+	{
+		static_assert(SH_TEX_SIZE % TilesPerFace == 0, "A tile must cover whole rows");
+		static_assert(SH_TEX_SIZE / TilesPerFace * SH_TEX_SIZE % SH_GROUP_SIZE == 0, "A tile must cover whole SH groups");
+		static_assert(CubeMapFaceCount * TilesPerFace <= 64, "The dirty tiles must fit in 64 bits");
+		m_coeffTiles = StructuredBuffer::MakeUnique();
+		XUSG_N_RETURN(m_coeffTiles->Create(pDevice, maxElements, sizeof(float[3]),
+			ResourceFlag::ALLOW_UNORDERED_ACCESS, MemoryType::DEFAULT,
+			1, nullptr, 1, nullptr, MemoryFlag::NONE, L"SHTileCoefficients"), false);
+		m_weightTiles = StructuredBuffer::MakeUnique();
+		XUSG_N_RETURN(m_weightTiles->Create(pDevice, numGroups, sizeof(float),
+			ResourceFlag::ALLOW_UNORDERED_ACCESS, MemoryType::DEFAULT,
+			1, nullptr, 1, nullptr, MemoryFlag::NONE, L"SHTileWeights"), false);
+	}
+
 	// Create constant buffers
 	m_cbPerFrame = ConstantBuffer::MakeUnique();
 	XUSG_N_RETURN(m_cbPerFrame->Create(pDevice, sizeof(float[FrameCount]), FrameCount,
@@ -96,22 +126,56 @@ void LightProbe::UpdateFrame(double time, uint8_t frameIndex)
 	// Update per-frame CB
 	{
 		static const auto period = 3.0;
+		const auto inputProbeIdx = m_inputProbeIdx;
 		const auto numSources = static_cast<uint32_t>(m_sources.size());
 		auto blend = static_cast<float>(time / period);
 		m_inputProbeIdx = static_cast<uint32_t>(time / period);
 		blend = numSources > 1 ? blend - m_inputProbeIdx : 0.0f;
 		m_inputProbeIdx %= numSources;
 		*reinterpret_cast<float*>(m_cbPerFrame->Map(frameIndex)) = blend;
+
+		// The whole radiance changes with the blend
+		if (blend != m_blend || m_inputProbeIdx != inputProbeIdx) m_dirtyTiles = ~0ull;
+		m_blend = blend;
 	}
 }
 
+void LightProbe::SetDirty(uint8_t face, float top, float bottom)
+{
+	assert(face < CubeMapFaceCount);
+	// Clamp to [0, 1] before converting to tile indices, NaNs included
+	const auto saturate = [](float y) { return y > 0.0f ? (y < 1.0f ? y : 1.0f) : 0.0f; };
+	const auto first = static_cast<uint32_t>(saturate(top) * TilesPerFace);
+	const auto last = static_cast<uint32_t>(ceil(saturate(bottom) * TilesPerFace));
+	for (auto i = first; i < last; ++i) m_dirtyTiles |= 1ull << (TilesPerFace * face + i);
+}
+
 void LightProbe::Process(CommandList* pCommandList, uint8_t frameIndex)
 {
 	const uint8_t order = 3;
 	generateRadiance(pCommandList, frameIndex);
-	shCubeMap(pCommandList, order);
-	shSum(pCommandList, order);
-	shNormalize(pCommandList, order);
+
+	if (m_shMode == SH_MODE_BLEND_CACHED)
+	{
+		if (!m_isSourceSHCached) shCacheSources(pCommandList, order);
+		shBlend(pCommandList, order);
+	}
+	else if (m_shMode == SH_MODE_INCREMENTAL)
+	{
+		// Otherwise, the coefficients of the last projection are still valid
+		if (m_dirtyTiles)
+		{
+			shCubeMapTiles(pCommandList, order);
+			shSum(pCommandList, order);
+			shNormalize(pCommandList, order);
+		}
+	}
+	else
+	{
+		shCubeMap(pCommandList, m_radiance.get(), m_srvTables[SRV_TABLE_RADIANCE][0], order);
+		shSum(pCommandList, order);
+		shNormalize(pCommandList, order);
+	}
 }
 
 ShaderResource* LightProbe::GetRadiance() const
@@ -144,7 +208,7 @@ bool LightProbe::createPipelineLayouts()
 		utilPipelineLayout->SetRootUAV(1, 0);
 		utilPipelineLayout->SetRootUAV(2, 1);
 		utilPipelineLayout->SetRange(3, DescriptorType::SRV, 1, 0);
-		utilPipelineLayout->SetConstants(4, XUSG_UINT32_SIZE_OF(uint32_t[2]), 0);
+		utilPipelineLayout->SetConstants(4, XUSG_UINT32_SIZE_OF(uint32_t[3]), 0);
 		XUSG_X_RETURN(m_pipelineLayouts[SH_CUBE_MAP], utilPipelineLayout->GetPipelineLayout(
 			m_pipelineLayoutLib.get(), PipelineLayoutFlag::NONE, L"SHCubeMapLayout"), false);
 	}
@@ -171,6 +235,17 @@ bool LightProbe::createPipelineLayouts()
 			m_pipelineLayoutLib.get(), PipelineLayoutFlag::NONE, L"SHNormalizeLayout"), false);
 	}
 
+	// SH blend
+	if (m_shMode == SH_MODE_BLEND_CACHED)
+	{
+		const auto utilPipelineLayout = Util::PipelineLayout::MakeUnique();
+		utilPipelineLayout->SetRootUAV(0, 0);
+		utilPipelineLayout->SetRootSRV(1, 0);
+		utilPipelineLayout->SetConstants(2, XUSG_UINT32_SIZE_OF(uint32_t[4]), 0);
+		XUSG_X_RETURN(m_pipelineLayouts[SH_BLEND], utilPipelineLayout->GetPipelineLayout(
+			m_pipelineLayoutLib.get(), PipelineLayoutFlag::NONE, L"SHBlendLayout"), false);
+	}
+
 	return true;
 }
 
@@ -214,10 +289,32 @@ bool LightProbe::createPipelines(Format rtFormat)
 
 		const auto state = Compute::State::MakeUnique();
 		state->SetPipelineLayout(m_pipelineLayouts[SH_NORMALIZE]);
-		state->SetShader(m_shaderLib->GetShader(Shader::Stage::CS, csIndex));
+		state->SetShader(m_shaderLib->GetShader(Shader::Stage::CS, csIndex++));
 		XUSG_X_RETURN(m_pipelines[SH_NORMALIZE], state->GetPipeline(m_computePipelineLib.get(), L"SHNormalize"), false);
 	}
 
+	// SH blend
+	if (m_shMode == SH_MODE_BLEND_CACHED)
+	{
+		XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::CS, csIndex, L"CSSHBlend.cso"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[SH_BLEND]);
+		state->SetShader(m_shaderLib->GetShader(Shader::Stage::CS, csIndex++));
+		XUSG_X_RETURN(m_pipelines[SH_BLEND], state->GetPipeline(m_computePipelineLib.get(), L"SHBlend"), false);
+	}
+
+	// Tiled SH cube map transform, sharing the layout of SH_CUBE_MAP
+	if (m_shMode == SH_MODE_INCREMENTAL)
+	{
+		XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::CS, csIndex, L"CSSHCubeMapTiled.cso"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[SH_CUBE_MAP]);
+		state->SetShader(m_shaderLib->GetShader(Shader::Stage::CS, csIndex));
+		XUSG_X_RETURN(m_pipelines[SH_CUBE_MAP_TILED], state->GetPipeline(m_computePipelineLib.get(), L"SHCubeMapTiled"), false);
+	}
+
 	return true;
 }
 
@@ -281,13 +378,14 @@ void LightProbe::generateRadiance(CommandList* pCommandList, uint8_t frameIndex)
 		3, m_samplerTable, 0, m_pipelines[RADIANCE_GEN]);
 }
 
-void LightProbe::shCubeMap(CommandList* pCommandList, uint8_t order)
+void LightProbe::shCubeMap(CommandList* pCommandList, Texture* pCubeMap,
+	const DescriptorTable& srvTable, uint8_t order)
 {
 	assert(order <= SH_MAX_ORDER);
 	ResourceBarrier barrier;
 	m_coeffSH[0]->SetBarrier(&barrier, ResourceState::UNORDERED_ACCESS);	// Promotion
 	m_weightSH[0]->SetBarrier(&barrier, ResourceState::UNORDERED_ACCESS);	// Promotion
-	const auto numBarriers = m_radiance->SetBarrier(&barrier,
+	const auto numBarriers = pCubeMap->SetBarrier(&barrier,
 		ResourceState::NON_PIXEL_SHADER_RESOURCE | ResourceState::PIXEL_SHADER_RESOURCE);
 	pCommandList->Barrier(numBarriers, &barrier);
 
@@ -295,7 +393,7 @@ void LightProbe::shCubeMap(CommandList* pCommandList, uint8_t order)
 	pCommandList->SetComputeDescriptorTable(0, m_samplerTable);
 	pCommandList->SetComputeRootUnorderedAccessView(1, m_coeffSH[0].get());
 	pCommandList->SetComputeRootUnorderedAccessView(2, m_weightSH[0].get());
-	pCommandList->SetComputeDescriptorTable(3, m_srvTables[SRV_TABLE_RADIANCE][0]);
+	pCommandList->SetComputeDescriptorTable(3, srvTable);
 	pCommandList->SetCompute32BitConstant(4, order);
 	pCommandList->SetCompute32BitConstant(4, SH_TEX_SIZE, XUSG_UINT32_SIZE_OF(order));
 	pCommandList->SetPipelineState(m_pipelines[SH_CUBE_MAP]);
@@ -313,24 +411,37 @@ void LightProbe::shSum(CommandList* pCommandList, uint8_t order)
 	pCommandList->SetCompute32BitConstant(4, order);
 	pCommandList->SetPipelineState(m_pipelines[SH_SUM]);
 
-	// Promotions
+	// Promotions; level 0 of SH_MODE_INCREMENTAL is in the tile buffers, so the first
+	// writes of m_coeffSH[0] and m_weightSH[0] are here
 	m_coeffSH[1]->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
 	m_weightSH[1]->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+	if (m_shMode == SH_MODE_INCREMENTAL)
+	{
+		m_coeffSH[0]->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+		m_weightSH[0]->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+	}
 
-	for (auto n = XUSG_DIV_UP(m_numSHTexels, SH_GROUP_SIZE); n > 1; n = XUSG_DIV_UP(n, SH_GROUP_SIZE))
+	const auto numGroups = XUSG_DIV_UP(m_numSHTexels, SH_GROUP_SIZE);
+	for (auto n = numGroups; n > 1; n = XUSG_DIV_UP(n, SH_GROUP_SIZE))
 	{
 		const auto& src = m_shBufferParity;
 		const uint8_t dst = !m_shBufferParity;
+
+		// The first level of SH_MODE_INCREMENTAL reads the cached partial sums of the tiles
+		const auto isTiles = m_shMode == SH_MODE_INCREMENTAL && n == numGroups;
+		const auto pSrcCoeffSH = isTiles ? m_coeffTiles.get() : m_coeffSH[src].get();
+		const auto pSrcWeightSH = isTiles ? m_weightTiles.get() : m_weightSH[src].get();
+
 		auto numBarriers = m_coeffSH[dst]->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
 		numBarriers = m_weightSH[dst]->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
-		numBarriers = m_coeffSH[src]->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE, numBarriers);
-		numBarriers = m_weightSH[src]->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE, numBarriers);
+		numBarriers = pSrcCoeffSH->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE, numBarriers);
+		numBarriers = pSrcWeightSH->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE, numBarriers);
 		pCommandList->Barrier(numBarriers, barriers);
 
 		pCommandList->SetComputeRootUnorderedAccessView(0, m_coeffSH[dst].get());
 		pCommandList->SetComputeRootUnorderedAccessView(1, m_weightSH[dst].get());
-		pCommandList->SetComputeRootShaderResourceView(2, m_coeffSH[src].get());
-		pCommandList->SetComputeRootShaderResourceView(3, m_weightSH[src].get());
+		pCommandList->SetComputeRootShaderResourceView(2, pSrcCoeffSH);
+		pCommandList->SetComputeRootShaderResourceView(3, pSrcWeightSH);
 		pCommandList->SetCompute32BitConstant(4, n, XUSG_UINT32_SIZE_OF(order));
 
 		pCommandList->Dispatch(XUSG_DIV_UP(n, SH_GROUP_SIZE), order * order, 1);
@@ -359,3 +470,113 @@ void LightProbe::shNormalize(CommandList* pCommandList, uint8_t order)
 	pCommandList->Dispatch(XUSG_DIV_UP(numElements, SH_GROUP_SIZE), 1, 1);
 	m_shBufferParity = !m_shBufferParity;
 }
+
+void LightProbe::shCubeMapTiles(CommandList* pCommandList, uint8_t order)
+{
+	assert(order <= SH_MAX_ORDER);
+	ResourceBarrier barrier;
+	m_coeffTiles->SetBarrier(&barrier, ResourceState::UNORDERED_ACCESS);		// Promotion
+	m_weightTiles->SetBarrier(&barrier, ResourceState::UNORDERED_ACCESS);	// Promotion
+	const auto numBarriers = m_radiance->SetBarrier(&barrier,
+		ResourceState::NON_PIXEL_SHADER_RESOURCE | ResourceState::PIXEL_SHADER_RESOURCE);
+	pCommandList->Barrier(numBarriers, &barrier);
+
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[SH_CUBE_MAP]);
+	pCommandList->SetComputeDescriptorTable(0, m_samplerTable);
+	pCommandList->SetComputeRootUnorderedAccessView(1, m_coeffTiles.get());
+	pCommandList->SetComputeRootUnorderedAccessView(2, m_weightTiles.get());
+	pCommandList->SetComputeDescriptorTable(3, m_srvTables[SRV_TABLE_RADIANCE][0]);
+	pCommandList->SetCompute32BitConstant(4, order);
+	pCommandList->SetCompute32BitConstant(4, SH_TEX_SIZE, XUSG_UINT32_SIZE_OF(order));
+	pCommandList->SetPipelineState(m_pipelines[SH_CUBE_MAP_TILED]);
+
+	// One dispatch per run of consecutive dirty tiles, the partial sums of the others are kept
+	const auto numGroupsPerTile = SH_TEX_SIZE / TilesPerFace * SH_TEX_SIZE / SH_GROUP_SIZE;
+	const auto numTiles = CubeMapFaceCount * TilesPerFace;
+	for (auto i = 0u; i < numTiles;)
+	{
+		if (!((m_dirtyTiles >> i) & 1))
+		{
+			++i;
+			continue;
+		}
+
+		auto j = i + 1;
+		while (j < numTiles && ((m_dirtyTiles >> j) & 1)) ++j;
+		pCommandList->SetCompute32BitConstant(4, numGroupsPerTile * i, XUSG_UINT32_SIZE_OF(uint32_t[2]));
+		pCommandList->Dispatch(numGroupsPerTile * (j - i), 1, 1);
+		i = j;
+	}
+
+	m_dirtyTiles = 0;
+}
+
+void LightProbe::shCacheSources(CommandList* pCommandList, uint8_t order)
+{
+	assert(order <= SH_MAX_ORDER);
+	ResourceBarrier barriers[4];
+	const auto numBytes = sizeof(float[3]) * order * order;
+	const auto numSources = static_cast<uint32_t>(m_sources.size());
+	for (auto i = 0u; i < numSources; ++i)
+	{
+		// The SH buffers do not decay to the common state between the sources
+		if (i > 0)
+		{
+			auto numBarriers = 0u;
+			for (auto& coeffSH : m_coeffSH)
+				numBarriers = coeffSH->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+			for (auto& weightSH : m_weightSH)
+				numBarriers = weightSH->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+			pCommandList->Barrier(numBarriers, barriers);
+		}
+
+		// Slot 0 of each input table is the source itself
+		shCubeMap(pCommandList, m_sources[i].get(), m_srvTables[SRV_TABLE_INPUT][i], order);
+		shSum(pCommandList, order);
+		shNormalize(pCommandList, order);
+
+		const auto& src = m_coeffSH[m_shBufferParity];
+		auto numBarriers = src->SetBarrier(barriers, ResourceState::COPY_SOURCE);
+		numBarriers = m_coeffSources->SetBarrier(barriers, ResourceState::COPY_DEST, numBarriers);
+		pCommandList->Barrier(numBarriers, barriers);
+
+		pCommandList->CopyBufferRegion(m_coeffSources.get(), numBytes * i, src.get(), 0, numBytes);
+	}
+
+	// Leave the buffers as shBlend() expects them in later frames after decaying
+	auto numBarriers = m_coeffSH[0]->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+	numBarriers = m_coeffSources->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	m_isSourceSHCached = true;
+}
+
+void LightProbe::shBlend(CommandList* pCommandList, uint8_t order)
+{
+	assert(order <= SH_MAX_ORDER);
+	ResourceBarrier barrier;
+	m_shBufferParity = 0;
+	m_coeffSH[0]->SetBarrier(&barrier, ResourceState::UNORDERED_ACCESS);	// Promotion
+	const auto numBarriers = m_coeffSources->SetBarrier(&barrier, ResourceState::NON_PIXEL_SHADER_RESOURCE);
+	pCommandList->Barrier(numBarriers, &barrier);
+
+	struct
+	{
+		uint32_t NumElements;
+		uint32_t Source1;
+		uint32_t Source2;
+		float Blend;
+	} cb;
+	cb.NumElements = order * order;
+	cb.Source1 = m_inputProbeIdx;
+	cb.Source2 = (m_inputProbeIdx + 1) % static_cast<uint32_t>(m_sources.size());
+	cb.Blend = m_blend;
+
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[SH_BLEND]);
+	pCommandList->SetComputeRootUnorderedAccessView(0, m_coeffSH[0].get());
+	pCommandList->SetComputeRootShaderResourceView(1, m_coeffSources.get());
+	pCommandList->SetCompute32BitConstants(2, XUSG_UINT32_SIZE_OF(cb), &cb);
+	pCommandList->SetPipelineState(m_pipelines[SH_BLEND]);
+
+	pCommandList->Dispatch(XUSG_DIV_UP(cb.NumElements, SH_GROUP_SIZE), 1, 1);
+}
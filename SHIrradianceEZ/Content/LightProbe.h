@@ -9,14 +9,25 @@
 class LightProbe
 {
 public:
+	enum SHMode : uint8_t
+	{
+		SH_MODE_REPROJECT,		// Projects the whole radiance every frame
+		SH_MODE_INCREMENTAL,	// Reprojects only the dirty tiles, and merges the cached partial sums
+		SH_MODE_BLEND_CACHED	// Projects each source once, and blends the coefficients every frame
+	};
+
 	LightProbe();
 	virtual ~LightProbe();
 
 	bool Init(XUSG::CommandList* pCommandList, const XUSG::DescriptorTableLib::sptr& descriptorTableLib,
-		std::vector<XUSG::Resource::uptr>& uploaders, const std::wstring pFileNames[], uint32_t numFiles);
+		std::vector<XUSG::Resource::uptr>& uploaders, const std::wstring pFileNames[], uint32_t numFiles,
+		SHMode shMode = SH_MODE_REPROJECT);
 	bool CreateDescriptorTables(XUSG::Device* pDevice);
 
 	void UpdateFrame(double time, uint8_t frameIndex);
+	// Marks rows [top, bottom) of a radiance face, in normalized texture coordinates, for
+	// reprojection in the next Process() of SH_MODE_INCREMENTAL
+	void SetDirty(uint8_t face, float top = 0.0f, float bottom = 1.0f);
 	void Process(XUSG::CommandList* pCommandList, uint8_t frameIndex);
 
 	XUSG::ShaderResource* GetRadiance() const;
@@ -24,14 +35,17 @@ public:
 
 	static const uint8_t FrameCount = 3;
 	static const uint8_t CubeMapFaceCount = 6;
+	static const uint8_t TilesPerFace = 8;	// Bands of rows, each covering whole SH groups
 
 protected:
 	enum PipelineIndex : uint8_t
 	{
 		RADIANCE_GEN,
 		SH_CUBE_MAP,
+		SH_CUBE_MAP_TILED,
 		SH_SUM,
 		SH_NORMALIZE,
+		SH_BLEND,
 
 		NUM_PIPELINE
 	};
@@ -49,9 +63,13 @@ protected:
 	bool createDescriptorTables();
 
 	void generateRadiance(XUSG::CommandList* pCommandList, uint8_t frameIndex);
-	void shCubeMap(XUSG::CommandList* pCommandList, uint8_t order);
+	void shCubeMap(XUSG::CommandList* pCommandList, XUSG::Texture* pCubeMap,
+		const XUSG::DescriptorTable& srvTable, uint8_t order);
 	void shSum(XUSG::CommandList* pCommandList, uint8_t order);
 	void shNormalize(XUSG::CommandList* pCommandList, uint8_t order);
+	void shCubeMapTiles(XUSG::CommandList* pCommandList, uint8_t order);
+	void shCacheSources(XUSG::CommandList* pCommandList, uint8_t order);
+	void shBlend(XUSG::CommandList* pCommandList, uint8_t order);
 
 	XUSG::ShaderLib::uptr				m_shaderLib;
 	XUSG::Graphics::PipelineLib::uptr	m_graphicsPipelineLib;
@@ -71,10 +89,17 @@ protected:
 
 	XUSG::StructuredBuffer::sptr m_coeffSH[2];
 	XUSG::StructuredBuffer::uptr m_weightSH[2];
+	XUSG::StructuredBuffer::uptr m_coeffSources;	// Projected once per source for blending in coefficient space
+	XUSG::StructuredBuffer::uptr m_coeffTiles;		// Per-group partial sums kept for SH_MODE_INCREMENTAL
+	XUSG::StructuredBuffer::uptr m_weightTiles;
 
 	XUSG::ConstantBuffer::uptr	m_cbPerFrame;
 
 	uint32_t				m_inputProbeIdx;
 	uint32_t				m_numSHTexels;
+	uint64_t				m_dirtyTiles;
 	uint8_t					m_shBufferParity;
+	SHMode					m_shMode;
+	float					m_blend;
+	bool					m_isSourceSHCached;
 };
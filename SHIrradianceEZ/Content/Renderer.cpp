@@ -3,7 +3,9 @@
 //--------------------------------------------------------------------------------------
 
 #include "DXFrameworkHelper.h"
+#include "Optional/XUSGMeshSimplifier.h"
 #include "Optional/XUSGObjLoader.h"
+#include "Optional/XUSGVertexQuantizer.h"
 #include "Renderer.h"
 #define _INDEPENDENT_HALTON_
 #include "Advanced/XUSGHalton.h"
@@ -13,12 +15,22 @@ using namespace std;
 using namespace DirectX;
 using namespace XUSG;
 
+// LOD chain: triangle ratios to the source, the max error relative to the mesh size,
+// and the screen-space error allowed when selecting a LOD
+const float g_lodRatios[] = { 0.5f, 0.25f, 0.125f, 0.0625f };
+const float g_lodMaxError = 0.05f;
+const float g_lodPixelError = 1.0f;
+
 struct CBBasePass
 {
 	XMFLOAT4X4	WorldViewProj;
 	XMFLOAT4X4	WorldViewProjPrev;
 	XMFLOAT3X4	World;
 	XMFLOAT2	ProjBias;
+	XMFLOAT2	Padding;
+	XMFLOAT3	PosScale;	// Dequantization of VERTEX_QUANTIZED_*
+	uint32_t	NormalFormat;
+	XMFLOAT3	PosBias;
 };
 
 struct CBPerFrame
@@ -28,7 +40,14 @@ struct CBPerFrame
 };
 
 Renderer::Renderer() :
-	m_frameParity(0)
+	m_maxIndices(0),
+	m_numVisibleIndices(),
+	m_frameParity(0),
+	m_lod(0),
+	m_vertexFormat(VERTEX_FLOAT),
+	m_dequantScale(1.0f, 1.0f, 1.0f),
+	m_dequantBias(0.0f, 0.0f, 0.0f),
+	m_pCulledIndices(nullptr)
 {
 	m_shaderLib = ShaderLib::MakeUnique();
 }
@@ -38,7 +57,8 @@ Renderer::~Renderer()
 }
 
 bool Renderer::Init(CommandList* pCommandList, const DescriptorTableLib::sptr& descriptorTableLib,
-	vector<Resource::uptr>& uploaders, const char* fileName, Format rtFormat, const XMFLOAT4& posScale)
+	vector<Resource::uptr>& uploaders, const char* fileName, Format rtFormat, const XMFLOAT4& posScale,
+	VertexFormat vertexFormat)
 {
 	const auto pDevice = pCommandList->GetDevice();
 	m_graphicsPipelineLib = Graphics::PipelineLib::MakeUnique(pDevice);
@@ -47,12 +67,41 @@ bool Renderer::Init(CommandList* pCommandList, const DescriptorTableLib::sptr& d
 	m_descriptorTableLib = descriptorTableLib;
 
 	m_posScale = posScale;
+	m_vertexFormat = vertexFormat;
 
 	// Load inputs
 	ObjLoader objLoader;
-	if (!objLoader.Import(fileName, true, true)) return false;
-	XUSG_N_RETURN(createVB(pCommandList, objLoader.GetNumVertices(), objLoader.GetVertexStride(), objLoader.GetVertices(), uploaders), false);
-	XUSG_N_RETURN(createIB(pCommandList, objLoader.GetNumIndices(), objLoader.GetIndices(), uploaders), false);
+	if (!objLoader.Import(fileName, true, true, true, false, true)) return false;
+	if (m_vertexFormat == VERTEX_FLOAT)
+	{
+		XUSG_N_RETURN(createVB(pCommandList, objLoader.GetNumVertices(), objLoader.GetVertexStride(), objLoader.GetVertices(), uploaders), false);
+	}
+	else
+	{
+		// Quantize the vertices relative to the AABB
+		VertexQuantizer quantizer(m_vertexFormat == VERTEX_QUANTIZED_OCTAHEDRAL ?
+			VertexQuantizer::NORMAL_OCTAHEDRAL : VertexQuantizer::NORMAL_R10G10B10A2);
+		vector<VertexQuantizer::Vertex> vertices;
+		const auto& aabb = objLoader.GetAABB();
+		quantizer.Quantize(vertices, objLoader.GetVertices(), objLoader.GetVertexStride(),
+			objLoader.GetNumVertices(), &aabb.Min.x, &aabb.Max.x);
+
+		const auto& dequant = quantizer.GetDequantization();
+		m_dequantScale = XMFLOAT3(dequant.Scale);
+		m_dequantBias = XMFLOAT3(dequant.Bias);
+		XUSG_N_RETURN(createVB(pCommandList, objLoader.GetNumVertices(), sizeof(VertexQuantizer::Vertex),
+			reinterpret_cast<const uint8_t*>(vertices.data()), uploaders), false);
+	}
+	XUSG_N_RETURN(createClusters(pDevice, fileName, objLoader.GetNumVertices(), objLoader.GetVertexStride(),
+		objLoader.GetVertices(), objLoader.GetNumIndices(), objLoader.GetIndices()), false);
+
+	{
+		const auto& aabb = objLoader.GetAABB();
+		const auto aabbMin = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&aabb.Min));
+		const auto aabbMax = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&aabb.Max));
+		XMStoreFloat4(&m_boundingSphere, XMVectorSetW((aabbMin + aabbMax) * 0.5f,
+			XMVectorGetX(XMVector3Length(aabbMax - aabbMin)) * 0.5f));
+	}
 
 	// Create constant buffers
 	m_cbBasePass = ConstantBuffer::MakeUnique();
@@ -134,7 +183,38 @@ void Renderer::UpdateFrame(uint8_t frameIndex, CXMVECTOR eyePt, CXMMATRIX viewPr
 		pCbData->WorldViewProjPrev = m_worldViewProj;
 		XMStoreFloat4x4(&pCbData->WorldViewProj, XMMatrixTranspose(world * viewProj));
 		XMStoreFloat3x4(&pCbData->World, world);
+		pCbData->PosScale = m_dequantScale;
+		pCbData->NormalFormat = m_vertexFormat == VERTEX_QUANTIZED_R10G10B10A2 ? 1 : 0;
+		pCbData->PosBias = m_dequantBias;
 		m_worldViewProj = pCbData->WorldViewProj;
+
+		// Select the coarsest LOD within the pixel error at the nearest point of the
+		// bounding sphere. The view is orthonormal, so the length of the second column of
+		// the view-projection is the y scale of the projection.
+		{
+			XMFLOAT4X4 vp;
+			XMStoreFloat4x4(&vp, viewProj);
+			const auto pixelsPerUnit = sqrt(vp._12 * vp._12 + vp._22 * vp._22 + vp._32 * vp._32) *
+				m_viewport.y * 0.5f * m_posScale.w;
+			const auto center = XMVector3TransformCoord(XMLoadFloat4(&m_boundingSphere), world);
+			const auto distance = XMVectorGetX(XMVector3Length(center - eyePt)) - m_boundingSphere.w * m_posScale.w;
+
+			auto lod = static_cast<uint8_t>(m_meshlets.size() - 1);
+			while (lod > 0 && (distance <= 0.0f || MeshSimplifier::GetScreenSpaceError(
+				m_lodErrors[lod], distance, pixelsPerUnit) > g_lodPixelError)) --lod;
+
+			if (lod != m_lod)
+			{
+				m_clusterCuller->Init(m_meshlets[lod].get());
+				m_lod = lod;
+			}
+		}
+
+		// Cull the clusters into the index list of this frame
+		XMFLOAT3 localEyePt;
+		XMStoreFloat3(&localEyePt, XMVector3TransformCoord(eyePt, XMMatrixInverse(nullptr, world)));
+		m_numVisibleIndices[frameIndex] = m_clusterCuller->Cull(&m_pCulledIndices[m_maxIndices * frameIndex],
+			&m_worldViewProj._11, &localEyePt.x);
 	}
 
 	{
@@ -208,27 +288,62 @@ bool Renderer::createVB(CommandList* pCommandList, uint32_t numVert,
 	return m_vertexBuffer->Upload(pCommandList, uploaders.back().get(), pData, stride * numVert);
 }
 
-bool Renderer::createIB(CommandList* pCommandList, uint32_t numIndices,
-	const uint32_t* pData, vector<Resource::uptr>& uploaders)
+bool Renderer::createClusters(const Device* pDevice, const char* fileName, uint32_t numVert,
+	uint32_t stride, const uint8_t* pVertices, uint32_t numIndices, const uint32_t* pIndices)
 {
-	m_numIndices = numIndices;
+	// LOD chain over the shared vertex buffer, clustered per LOD. The simplification costs
+	// far more than the import, so the chain is cached next to the mesh.
+	MeshSimplifier simplifier;
+	const auto numRatios = static_cast<uint32_t>(size(g_lodRatios));
+	const auto lodFileName = string(fileName) + ".xlod";
+	const auto sourceKey = MeshSimplifier::GetSourceKey(pVertices, stride, numVert,
+		pIndices, numIndices, g_lodRatios, numRatios, g_lodMaxError);
+	if (!simplifier.Load(lodFileName.c_str(), sourceKey))
+	{
+		XUSG_N_RETURN(simplifier.Build(pVertices, stride, numVert, pIndices, numIndices,
+			g_lodRatios, numRatios, g_lodMaxError), false);
+		simplifier.Save(lodFileName.c_str(), sourceKey);
+	}
+
+	const auto numLODs = simplifier.GetNumLODs();
+	const auto pLODs = simplifier.GetLODs();
+	m_meshlets.resize(numLODs);
+	m_lodErrors.resize(numLODs);
+	for (auto i = 0u; i < numLODs; ++i)
+	{
+		m_meshlets[i] = make_unique<MeshletBuilder>();
+		XUSG_N_RETURN(m_meshlets[i]->Build(pVertices, stride, numVert,
+			&simplifier.GetIndices()[pLODs[i].IndexOffset], pLODs[i].NumIndices), false);
+		m_lodErrors[i] = pLODs[i].Error;
+	}
+
+	// LOD 0 has the most indices
+	m_lod = 0;
+	m_clusterCuller = make_unique<ClusterCuller>();
+	XUSG_N_RETURN(m_clusterCuller->Init(m_meshlets[m_lod].get()), false);
+
+	// One index list per frame in flight, written by the CPU culling
+	m_maxIndices = m_clusterCuller->GetMaxIndices();
+	const uint32_t byteWidth = sizeof(uint32_t) * m_maxIndices;
+	uintptr_t ibvByteOffsets[FrameCount];
+	for (uint8_t i = 0; i < FrameCount; ++i) ibvByteOffsets[i] = byteWidth * i;
 
-	const uint32_t byteWidth = sizeof(uint32_t) * numIndices;
 	m_indexBuffer = IndexBuffer::MakeUnique();
-	XUSG_N_RETURN(m_indexBuffer->Create(pCommandList->GetDevice(), byteWidth, Format::R32_UINT, ResourceFlag::NONE,
-		MemoryType::DEFAULT, 1, nullptr, 1, nullptr, 1, nullptr, MemoryFlag::NONE, L"MeshIB"), false);
-	uploaders.emplace_back(Resource::MakeUnique());
+	XUSG_N_RETURN(m_indexBuffer->Create(pDevice, byteWidth * FrameCount, Format::R32_UINT, ResourceFlag::NONE,
+		MemoryType::UPLOAD, FrameCount, ibvByteOffsets, 1, nullptr, 1, nullptr, MemoryFlag::NONE, L"MeshIB"), false);
+	m_pCulledIndices = reinterpret_cast<uint32_t*>(m_indexBuffer->Map());
 
-	return m_indexBuffer->Upload(pCommandList, uploaders.back().get(), pData, byteWidth);
+	return m_pCulledIndices != nullptr;
 }
 
 bool Renderer::createInputLayout()
 {
 	// Define the vertex input layout.
+	const auto isQuantized = m_vertexFormat != VERTEX_FLOAT;
 	const InputElement inputElements[] =
 	{
-		{ "POSITION",	0, Format::R32G32B32_FLOAT, 0, 0,								InputClassification::PER_VERTEX_DATA, 0 },
-		{ "NORMAL",		0, Format::R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT,	InputClassification::PER_VERTEX_DATA, 0 }
+		{ "POSITION",	0, isQuantized ? Format::R16G16B16A16_UNORM : Format::R32G32B32_FLOAT, 0, 0,	InputClassification::PER_VERTEX_DATA, 0 },
+		{ "NORMAL",		0, isQuantized ? Format::R32_UINT : Format::R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT,	InputClassification::PER_VERTEX_DATA, 0 }
 	};
 
 	XUSG_X_RETURN(m_pInputLayout, m_graphicsPipelineLib->CreateInputLayout(inputElements, static_cast<uint32_t>(size(inputElements))), false);
@@ -294,7 +409,8 @@ bool Renderer::createPipelines(Format rtFormat)
 	auto csIndex = 0u;
 
 	// Base pass
-	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::VS, vsIndex, L"VSBasePass.cso"), false);
+	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::VS, vsIndex,
+		m_vertexFormat == VERTEX_FLOAT ? L"VSBasePass.cso" : L"VSBasePassQuantized.cso"), false);
 	{
 		XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::PS, psIndex, L"PSBasePassSH.cso"), false);
 
@@ -443,9 +559,9 @@ void Renderer::render(CommandList* pCommandList, uint8_t frameIndex, bool needCl
 	pCommandList->SetGraphicsRootShaderResourceView(BUFFER, m_coeffSH.get());
 
 	pCommandList->IASetVertexBuffers(0, 1, &m_vertexBuffer->GetVBV());
-	pCommandList->IASetIndexBuffer(m_indexBuffer->GetIBV());
+	pCommandList->IASetIndexBuffer(m_indexBuffer->GetIBV(frameIndex));
 
-	pCommandList->DrawIndexed(m_numIndices, 1, 0, 0, 0);
+	pCommandList->DrawIndexed(m_numVisibleIndices[frameIndex], 1, 0, 0, 0);
 }
 
 void Renderer::environment(const CommandList* pCommandList, uint8_t frameIndex)
@@ -5,16 +5,25 @@
 #pragma once
 
 #include "Helper/XUSG-EZ.h"
+#include "Optional/XUSGClusterCuller.h"
 
 class Renderer
 {
 public:
+	enum VertexFormat : uint8_t
+	{
+		VERTEX_FLOAT,					// Float3 position and normal, 24 bytes
+		VERTEX_QUANTIZED_OCTAHEDRAL,	// 16-bit position and octahedral normal, 12 bytes
+		VERTEX_QUANTIZED_R10G10B10A2	// 16-bit position and 10:10:10:2 normal, 12 bytes
+	};
+
 	Renderer();
 	virtual ~Renderer();
 
 	bool Init(XUSG::CommandList* pCommandList, const XUSG::DescriptorTableLib::sptr& descriptorTableLib,
 		std::vector<XUSG::Resource::uptr>& uploaders, const char* fileName, XUSG::Format rtFormat,
-		const DirectX::XMFLOAT4& posScale = DirectX::XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+		const DirectX::XMFLOAT4& posScale = DirectX::XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f),
+		VertexFormat vertexFormat = VERTEX_FLOAT);
 	bool SetViewport(const XUSG::Device* pDevice, uint32_t width, uint32_t height);
 	bool SetLightProbe(const XUSG::Descriptor& radiance);
 
@@ -86,8 +95,8 @@ protected:
 
 	bool createVB(XUSG::CommandList* pCommandList, uint32_t numVert,
 		uint32_t stride, const uint8_t* pData, std::vector<XUSG::Resource::uptr>& uploaders);
-	bool createIB(XUSG::CommandList* pCommandList, uint32_t numIndices,
-		const uint32_t* pData, std::vector<XUSG::Resource::uptr>& uploaders);
+	bool createClusters(const XUSG::Device* pDevice, const char* fileName, uint32_t numVert,
+		uint32_t stride, const uint8_t* pVertices, uint32_t numIndices, const uint32_t* pIndices);
 	bool createInputLayout();
 	bool createPipelineLayouts();
 	bool createPipelines(XUSG::Format rtFormat);
@@ -97,11 +106,17 @@ protected:
 	void environment(const XUSG::CommandList* pCommandList, uint8_t frameIndex);
 	void temporalAA(XUSG::CommandList* pCommandList);
 
-	uint32_t	m_numIndices;
+	uint32_t	m_maxIndices;
+	uint32_t	m_numVisibleIndices[FrameCount];
 	uint8_t		m_frameParity;
+	uint8_t		m_lod;
+	VertexFormat m_vertexFormat;
 
 	DirectX::XMUINT2	m_viewport;
 	DirectX::XMFLOAT4	m_posScale;
+	DirectX::XMFLOAT3	m_dequantScale;
+	DirectX::XMFLOAT3	m_dequantBias;
+	DirectX::XMFLOAT4	m_boundingSphere;	// Object space
 	DirectX::XMFLOAT4X4	m_worldViewProj;
 
 	const XUSG::InputLayout* m_pInputLayout;
@@ -115,7 +130,12 @@ protected:
 	XUSG::Framebuffer		m_framebuffer;
 
 	XUSG::VertexBuffer::uptr	m_vertexBuffer;
-	XUSG::IndexBuffer::uptr		m_indexBuffer;
+	XUSG::IndexBuffer::uptr		m_indexBuffer;	// Ring of per-frame culled index lists in upload memory
+	uint32_t*					m_pCulledIndices;
+
+	std::vector<std::unique_ptr<XUSG::MeshletBuilder>> m_meshlets;	// Per LOD
+	std::vector<float>						m_lodErrors;			// Object space
+	std::unique_ptr<XUSG::ClusterCuller>	m_clusterCuller;
 
 	XUSG::RenderTarget::uptr	m_renderTargets[NUM_RENDER_TARGET];
 	XUSG::Texture2D::uptr		m_outputViews[NUM_OUTPUT_VIEW];
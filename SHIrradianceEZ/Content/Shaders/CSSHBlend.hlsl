@@ -0,0 +1,36 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "XUSGSHSharedConsts.h"
+
+//--------------------------------------------------------------------------------------
+// Constant buffer
+//--------------------------------------------------------------------------------------
+cbuffer cb
+{
+	uint g_numElements;
+	uint g_source1;
+	uint g_source2;
+	float g_blend;
+};
+
+//--------------------------------------------------------------------------------------
+// Buffers
+//--------------------------------------------------------------------------------------
+RWStructuredBuffer<float3> g_rwSHResult;
+StructuredBuffer<float3> g_roSHSources;
+
+//--------------------------------------------------------------------------------------
+// Compute shader that blends the cached SH coefficients of 2 sources
+//--------------------------------------------------------------------------------------
+[numthreads(SH_GROUP_SIZE, 1, 1)]
+void main(uint DTid : SV_DispatchThreadID)
+{
+	if (DTid >= g_numElements) return;
+
+	const float3 sh1 = g_roSHSources[g_numElements * g_source1 + DTid];
+	const float3 sh2 = g_roSHSources[g_numElements * g_source2 + DTid];
+
+	g_rwSHResult[DTid] = lerp(sh1, sh2, g_blend);
+}
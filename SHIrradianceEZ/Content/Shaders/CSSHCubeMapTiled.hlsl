@@ -0,0 +1,6 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#define _TILED_
+#include "CSSHCubeMap.hlsl"
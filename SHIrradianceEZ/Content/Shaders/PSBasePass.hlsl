@@ -38,8 +38,12 @@ cbuffer cbPerFrame
 //--------------------------------------------------------------------------------------
 TextureCube<float3>	g_txRadiance	: register (t0);
 #ifndef SH_ORDER
+#ifdef _OCTAHEDRAL_IRRADIANCE_
+Texture2D<float3>	g_txIrradiance	: register (t1);
+#else
 TextureCube<float3>	g_txIrradiance	: register (t1);
 #endif
+#endif
 
 //--------------------------------------------------------------------------------------
 // Sampler
@@ -98,6 +102,19 @@ PSOut Shade(PSIn input, min16float3 norm, float3 irradiance)
 	return output;
 }
 
+#ifdef _OCTAHEDRAL_IRRADIANCE_
+//--------------------------------------------------------------------------------------
+// Octahedral map of XUSG::IrradianceMapGenerator::EncodeOctahedral()
+//--------------------------------------------------------------------------------------
+float2 EncodeOctahedral(float3 dir)
+{
+	dir /= dot(abs(dir), 1.0);
+	if (dir.z < 0.0) dir.xy = (1.0 - abs(dir.yx)) * (dir.xy >= 0.0 ? 1.0 : -1.0);
+
+	return dir.xy * 0.5 + 0.5;
+}
+#endif
+
 //--------------------------------------------------------------------------------------
 // Base geometry-buffer pass
 //--------------------------------------------------------------------------------------
@@ -106,7 +123,11 @@ PSOut main(PSIn input)
 {
 	const min16float3 norm = min16float3(normalize(input.Norm));
 	//float3 irradiance = g_txIrradiance.Sample(g_sampler, input.Norm);
+#ifdef _OCTAHEDRAL_IRRADIANCE_
+	float3 irradiance = g_txIrradiance.SampleLevel(g_sampler, EncodeOctahedral(input.Norm), 0.0);
+#else
 	float3 irradiance = g_txIrradiance.SampleLevel(g_sampler, input.Norm, 0.0);
+#endif
 	irradiance *= PI;
 
 	return Shade(input, norm, irradiance);
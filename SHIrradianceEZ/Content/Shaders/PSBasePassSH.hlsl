@@ -2,7 +2,9 @@
 // Copyright (c) XU, Tianchen. All rights reserved.
 //--------------------------------------------------------------------------------------
 
+#ifndef SH_ORDER
 #define SH_ORDER 3
+#endif
 #include "SHIrradiance.hlsli"
 #include "PSBasePass.hlsl"
 
@@ -17,7 +19,11 @@ StructuredBuffer<float3> g_roSHBuff;
 PSOut main(PSIn input)
 {
 	const min16float3 norm = min16float3(normalize(input.Norm));
+#if SH_ORDER == 3 && SH_WINDOW == 0
 	const float4 irradiance = EvaluateSHIrradiance(g_roSHBuff, norm);
+#else
+	const float4 irradiance = EvaluateSHIrradianceGeneric(g_roSHBuff, norm);
+#endif
 
 	return Shade(input, norm, irradiance.xyz);
 }
@@ -7,8 +7,13 @@
 //--------------------------------------------------------------------------------------
 struct VSIn
 {
+#ifdef _QUANTIZED_
+	float4	Pos	: POSITION;	// R16G16B16A16_UNORM relative to the mesh AABB
+	uint	Nrm	: NORMAL;	// Octahedral R16G16_SNORM or R10G10B10A2_UNORM bits
+#else
 	float3	Pos	: POSITION;
 	float3	Nrm	: NORMAL;
+#endif
 };
 
 struct VSOut
@@ -29,8 +34,41 @@ cbuffer cbPerObject
 	matrix	g_worldViewProjPrev;
 	float4x3 g_world;
 	float2	g_projBias;
+#ifdef _QUANTIZED_
+	float3	g_posScale;
+	uint	g_normalFormat;
+	float3	g_posBias;
+#endif
 };
 
+#ifdef _QUANTIZED_
+//--------------------------------------------------------------------------------------
+// Normal decoding, matching XUSG::VertexQuantizer
+//--------------------------------------------------------------------------------------
+float3 DecodeNormal(uint bits)
+{
+	float3 n;
+	if (g_normalFormat)
+	{
+		// R10G10B10A2_UNORM
+		n = uint3(bits, bits >> 10, bits >> 20) & 0x3ff;
+		n = n / 1023.0 * 2.0 - 1.0;
+	}
+	else
+	{
+		// Octahedral R16G16_SNORM
+		const int2 e = int2(bits << 16, bits) >> 16;
+		n.xy = max(e / 32767.0, -1.0);
+		n.z = 1.0 - abs(n.x) - abs(n.y);
+
+		const float t = saturate(-n.z);
+		n.xy += n.xy >= 0.0 ? -t : t;
+	}
+
+	return normalize(n);
+}
+#endif
+
 //--------------------------------------------------------------------------------------
 // Base geometry pass
 //--------------------------------------------------------------------------------------
@@ -38,14 +76,20 @@ VSOut main(VSIn input)
 {
 	VSOut output;
 
+#ifdef _QUANTIZED_
+	const float4 pos = { input.Pos.xyz * g_posScale + g_posBias, 1.0 };
+	const float3 nrm = DecodeNormal(input.Nrm);
+#else
 	const float4 pos = { input.Pos, 1.0 };
+	const float3 nrm = input.Nrm;
+#endif
 	output.Pos = mul(pos, g_worldViewProj);
 	output.WSPos = mul(pos, g_world);
 	output.TSPos = mul(pos, g_worldViewProjPrev);
 	output.CSPos = output.Pos;
 
 	output.Pos.xy += g_projBias * output.Pos.w;
-	output.Norm = mul(input.Nrm, (float3x3)g_world);
+	output.Norm = mul(nrm, (float3x3)g_world);
 
 	return output;
 }
@@ -0,0 +1,6 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#define _QUANTIZED_
+#include "VSBasePass.hlsl"
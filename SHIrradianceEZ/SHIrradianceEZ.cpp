@@ -32,6 +32,8 @@ SHIrradianceEZ::SHIrradianceEZ(uint32_t width, uint32_t height, wstring name) :
 	m_tracking(false),
 	m_meshFileName("Assets/bunny.obj"),
 	m_meshPosScale(0.0f, 0.0f, 0.0f, 1.0f),
+	m_vertexFormat(Renderer::VERTEX_FLOAT),
+	m_shMode(LightProbe::SH_MODE_REPROJECT),
 	m_screenShot(0)
 {
 #if defined (_DEBUG)
@@ -175,11 +177,12 @@ void SHIrradianceEZ::LoadAssets()
 	{
 		m_lightProbe = make_unique<LightProbe>();
 		XUSG_N_RETURN(m_lightProbe->Init(pCommandList, m_descriptorTableLib, uploaders,
-			m_envFileNames.data(), static_cast<uint32_t>(m_envFileNames.size())), ThrowIfFailed(E_FAIL));
+			m_envFileNames.data(), static_cast<uint32_t>(m_envFileNames.size()), m_shMode),
+			ThrowIfFailed(E_FAIL));
 
 		m_renderer = make_unique<Renderer>();
 		XUSG_N_RETURN(m_renderer->Init(pCommandList, m_descriptorTableLib, uploaders,
-			m_meshFileName.c_str(), g_backBufferFormat, m_meshPosScale), ThrowIfFailed(E_FAIL));
+			m_meshFileName.c_str(), g_backBufferFormat, m_meshPosScale, m_vertexFormat), ThrowIfFailed(E_FAIL));
 	}
 
 	{
@@ -510,6 +513,18 @@ void SHIrradianceEZ::ParseCommandLineArgs(wchar_t* argv[], int argc)
 			if (hasNextArgValue(i)) i += swscanf_s(argv[i + 1], L"%f", &m_meshPosScale.z);
 			if (hasNextArgValue(i)) i += swscanf_s(argv[i + 1], L"%f", &m_meshPosScale.w);
 		}
+		else if (isArgMatched(i, L"quantize"))
+		{
+			m_vertexFormat = Renderer::VERTEX_QUANTIZED_OCTAHEDRAL;
+			if (hasNextArgValue(i) && str_tolower(argv[i + 1]) == L"r10g10b10a2")
+			{
+				m_vertexFormat = Renderer::VERTEX_QUANTIZED_R10G10B10A2;
+				++i;
+			}
+			else if (hasNextArgValue(i) && str_tolower(argv[i + 1]) == L"oct") ++i;
+		}
+		else if (isArgMatched(i, L"shblend")) m_shMode = LightProbe::SH_MODE_BLEND_CACHED;
+		else if (isArgMatched(i, L"shincremental")) m_shMode = LightProbe::SH_MODE_INCREMENTAL;
 		else if (isArgMatched(i, L"env"))
 		{
 			m_envFileNames.clear();
@@ -105,6 +105,8 @@ private:
 	std::string m_meshFileName;
 	std::vector<std::wstring> m_envFileNames;
 	XMFLOAT4 m_meshPosScale;
+	Renderer::VertexFormat m_vertexFormat;
+	LightProbe::SHMode m_shMode;
 
 	// Screen-shot helpers and state
 	XUSG::Buffer::uptr	m_readBuffer;
@@ -0,0 +1,406 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstring>
+#include "XUSGBC6HDecoder.h"
+
+using namespace std;
+using namespace XUSG;
+
+namespace
+{
+	// Header fields: endpoints w, x, y, z of the red, green and blue channels, and the partition
+	enum Field : uint8_t
+	{
+		RW, RX, RY, RZ,
+		GW, GX, GY, GZ,
+		BW, BX, BY, BZ,
+		D
+	};
+
+	// Bits First to Last of a field, in the stream order. First > Last for the reversed runs.
+	struct HeaderRun
+	{
+		uint8_t Field;
+		uint8_t First;
+		uint8_t Last;
+	};
+
+	struct ModeDesc
+	{
+		uint8_t ModeBits;
+		uint8_t NumRegions;
+		bool Transformed;
+		uint8_t EndpointBits;
+		uint8_t DeltaBits[3];
+		uint8_t NumRuns;
+		HeaderRun Runs[24];
+	};
+
+	// Bit layouts of the 14 modes in the BC6H specification
+	const ModeDesc ModeDescs[] =
+	{
+		{ 2, 2, true, 10, { 5, 5, 5 }, 20,
+		{
+			{ GY, 4, 4 }, { BY, 4, 4 }, { BZ, 4, 4 }, { RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 4 },
+			{ GZ, 4, 4 }, { GY, 0, 3 }, { GX, 0, 4 }, { BZ, 0, 0 }, { GZ, 0, 3 }, { BX, 0, 4 }, { BZ, 1, 1 },
+			{ BY, 0, 3 }, { RY, 0, 4 }, { BZ, 2, 2 }, { RZ, 0, 4 }, { BZ, 3, 3 }, { D, 0, 4 }
+		} },
+		{ 2, 2, true, 7, { 6, 6, 6 }, 24,
+		{
+			{ GY, 5, 5 }, { GZ, 4, 4 }, { GZ, 5, 5 }, { RW, 0, 6 }, { BZ, 0, 0 }, { BZ, 1, 1 }, { BY, 4, 4 },
+			{ GW, 0, 6 }, { BY, 5, 5 }, { BZ, 2, 2 }, { GY, 4, 4 }, { BW, 0, 6 }, { BZ, 3, 3 }, { BZ, 5, 5 },
+			{ BZ, 4, 4 }, { RX, 0, 5 }, { GY, 0, 3 }, { GX, 0, 5 }, { GZ, 0, 3 }, { BX, 0, 5 }, { BY, 0, 3 },
+			{ RY, 0, 5 }, { RZ, 0, 5 }, { D, 0, 4 }
+		} },
+		{ 5, 2, true, 11, { 5, 4, 4 }, 19,
+		{
+			{ RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 4 }, { RW, 10, 10 }, { GY, 0, 3 }, { GX, 0, 3 },
+			{ GW, 10, 10 }, { BZ, 0, 0 }, { GZ, 0, 3 }, { BX, 0, 3 }, { BW, 10, 10 }, { BZ, 1, 1 }, { BY, 0, 3 },
+			{ RY, 0, 4 }, { BZ, 2, 2 }, { RZ, 0, 4 }, { BZ, 3, 3 }, { D, 0, 4 }
+		} },
+		{ 5, 2, true, 11, { 4, 5, 4 }, 21,
+		{
+			{ RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 3 }, { RW, 10, 10 }, { GZ, 4, 4 }, { GY, 0, 3 },
+			{ GX, 0, 4 }, { GW, 10, 10 }, { GZ, 0, 3 }, { BX, 0, 3 }, { BW, 10, 10 }, { BZ, 1, 1 }, { BY, 0, 3 },
+			{ RY, 0, 3 }, { BZ, 0, 0 }, { BZ, 2, 2 }, { RZ, 0, 3 }, { GY, 4, 4 }, { BZ, 3, 3 }, { D, 0, 4 }
+		} },
+		{ 5, 2, true, 11, { 4, 4, 5 }, 21,
+		{
+			{ RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 3 }, { RW, 10, 10 }, { BY, 4, 4 }, { GY, 0, 3 },
+			{ GX, 0, 3 }, { GW, 10, 10 }, { BZ, 0, 0 }, { GZ, 0, 3 }, { BX, 0, 4 }, { BW, 10, 10 }, { BY, 0, 3 },
+			{ RY, 0, 3 }, { BZ, 1, 1 }, { BZ, 2, 2 }, { RZ, 0, 3 }, { BZ, 4, 4 }, { BZ, 3, 3 }, { D, 0, 4 }
+		} },
+		{ 5, 2, true, 9, { 5, 5, 5 }, 20,
+		{
+			{ RW, 0, 8 }, { BY, 4, 4 }, { GW, 0, 8 }, { GY, 4, 4 }, { BW, 0, 8 }, { BZ, 4, 4 }, { RX, 0, 4 },
+			{ GZ, 4, 4 }, { GY, 0, 3 }, { GX, 0, 4 }, { BZ, 0, 0 }, { GZ, 0, 3 }, { BX, 0, 4 }, { BZ, 1, 1 },
+			{ BY, 0, 3 }, { RY, 0, 4 }, { BZ, 2, 2 }, { RZ, 0, 4 }, { BZ, 3, 3 }, { D, 0, 4 }
+		} },
+		{ 5, 2, true, 8, { 6, 5, 5 }, 20,
+		{
+			{ RW, 0, 7 }, { GZ, 4, 4 }, { BY, 4, 4 }, { GW, 0, 7 }, { BZ, 2, 2 }, { GY, 4, 4 }, { BW, 0, 7 },
+			{ BZ, 3, 3 }, { BZ, 4, 4 }, { RX, 0, 5 }, { GY, 0, 3 }, { GX, 0, 4 }, { BZ, 0, 0 }, { GZ, 0, 3 },
+			{ BX, 0, 4 }, { BZ, 1, 1 }, { BY, 0, 3 }, { RY, 0, 5 }, { RZ, 0, 5 }, { D, 0, 4 }
+		} },
+		{ 5, 2, true, 8, { 5, 6, 5 }, 22,
+		{
+			{ RW, 0, 7 }, { BZ, 0, 0 }, { BY, 4, 4 }, { GW, 0, 7 }, { GY, 5, 5 }, { GY, 4, 4 }, { BW, 0, 7 },
+			{ GZ, 5, 5 }, { BZ, 4, 4 }, { RX, 0, 4 }, { GZ, 4, 4 }, { GY, 0, 3 }, { GX, 0, 5 }, { GZ, 0, 3 },
+			{ BX, 0, 4 }, { BZ, 1, 1 }, { BY, 0, 3 }, { RY, 0, 4 }, { BZ, 2, 2 }, { RZ, 0, 4 }, { BZ, 3, 3 },
+			{ D, 0, 4 }
+		} },
+		{ 5, 2, true, 8, { 5, 5, 6 }, 22,
+		{
+			{ RW, 0, 7 }, { BZ, 1, 1 }, { BY, 4, 4 }, { GW, 0, 7 }, { BY, 5, 5 }, { GY, 4, 4 }, { BW, 0, 7 },
+			{ BZ, 5, 5 }, { BZ, 4, 4 }, { RX, 0, 4 }, { GZ, 4, 4 }, { GY, 0, 3 }, { GX, 0, 4 }, { BZ, 0, 0 },
+			{ GZ, 0, 3 }, { BX, 0, 5 }, { BY, 0, 3 }, { RY, 0, 4 }, { BZ, 2, 2 }, { RZ, 0, 4 }, { BZ, 3, 3 },
+			{ D, 0, 4 }
+		} },
+		{ 5, 2, false, 6, { 6, 6, 6 }, 24,
+		{
+			{ RW, 0, 5 }, { GZ, 4, 4 }, { BZ, 0, 0 }, { BZ, 1, 1 }, { BY, 4, 4 }, { GW, 0, 5 }, { GY, 5, 5 },
+			{ BY, 5, 5 }, { BZ, 2, 2 }, { GY, 4, 4 }, { BW, 0, 5 }, { GZ, 5, 5 }, { BZ, 3, 3 }, { BZ, 5, 5 },
+			{ BZ, 4, 4 }, { RX, 0, 5 }, { GY, 0, 3 }, { GX, 0, 5 }, { GZ, 0, 3 }, { BX, 0, 5 }, { BY, 0, 3 },
+			{ RY, 0, 5 }, { RZ, 0, 5 }, { D, 0, 4 }
+		} },
+		{ 5, 1, false, 10, { 10, 10, 10 }, 6,
+		{
+			{ RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 9 }, { GX, 0, 9 }, { BX, 0, 9 }
+		} },
+		{ 5, 1, true, 11, { 9, 9, 9 }, 9,
+		{
+			{ RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 8 }, { RW, 10, 10 }, { GX, 0, 8 }, { GW, 10, 10 },
+			{ BX, 0, 8 }, { BW, 10, 10 }
+		} },
+		{ 5, 1, true, 12, { 8, 8, 8 }, 9,
+		{
+			{ RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 7 }, { RW, 11, 10 }, { GX, 0, 7 }, { GW, 11, 10 },
+			{ BX, 0, 7 }, { BW, 11, 10 }
+		} },
+		{ 5, 1, true, 16, { 4, 4, 4 }, 9,
+		{
+			{ RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 3 }, { RW, 15, 10 }, { GX, 0, 3 }, { GW, 15, 10 },
+			{ BX, 0, 3 }, { BW, 15, 10 }
+		} }
+	};
+
+	// Mode descriptor indices of the 5-bit mode values, 0xff for the reserved ones
+	const uint8_t ModeIndices[32] =
+	{
+		0, 1, 2, 10, 0, 1, 3, 11, 0, 1, 4, 12, 0, 1, 5, 13,
+		0, 1, 6, 0xff, 0, 1, 7, 0xff, 0, 1, 8, 0xff, 0, 1, 9, 0xff
+	};
+
+	// Region of each texel as a bit mask, and the anchor texel of the second region
+	const uint16_t Partitions[32] =
+	{
+		0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+		0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+		0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+		0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c
+	};
+
+	const uint8_t Anchors[32] =
+	{
+		15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+		15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2
+	};
+
+	const int32_t Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	const int32_t Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	class BitReader
+	{
+	public:
+		BitReader(const uint8_t block[16]) : m_pos(0)
+		{
+			memcpy(m_bits, block, sizeof(m_bits));
+		}
+
+		uint32_t Read(uint32_t numBits)
+		{
+			const auto lo = m_pos < 64 ? m_bits[0] >> m_pos : 0;
+			const auto hi = m_pos == 0 ? 0 : (m_pos < 64 ? m_bits[1] << (64 - m_pos) : m_bits[1] >> (m_pos - 64));
+			m_pos += numBits;
+
+			return static_cast<uint32_t>((lo | hi) & ((1ull << numBits) - 1));
+		}
+
+		void Seek(uint32_t pos) { m_pos = pos; }
+
+	protected:
+		uint64_t m_bits[2];
+		uint32_t m_pos;
+	};
+
+	inline int32_t signExtend(int32_t value, uint32_t numBits)
+	{
+		const auto shift = 32 - numBits;
+
+		return static_cast<int32_t>(static_cast<uint32_t>(value) << shift) >> shift;
+	}
+
+	inline int32_t unquantize(int32_t comp, uint32_t numBits, bool isSigned)
+	{
+		if (isSigned)
+		{
+			if (numBits >= 16) return comp;
+
+			const auto isNegative = comp < 0;
+			if (isNegative) comp = -comp;
+
+			int32_t unq;
+			if (comp == 0) unq = 0;
+			else if (comp >= (1 << (numBits - 1)) - 1) unq = 0x7fff;
+			else unq = ((comp << 15) + 0x4000) >> (numBits - 1);
+
+			return isNegative ? -unq : unq;
+		}
+
+		if (numBits >= 15) return comp;
+		if (comp == 0) return 0;
+		if (comp == (1 << numBits) - 1) return 0xffff;
+
+		return ((comp << 16) + 0x8000) >> numBits;
+	}
+
+	inline uint16_t finishUnquantize(int32_t comp, bool isSigned)
+	{
+		if (isSigned) return static_cast<uint16_t>(comp < 0 ? (((-comp) * 31) >> 5) | 0x8000 : (comp * 31) >> 5);
+
+		return static_cast<uint16_t>((comp * 31) >> 6);
+	}
+
+	template<typename T>
+	inline T convertHalf(uint16_t value);
+
+	template<>
+	inline float convertHalf(uint16_t value)
+	{
+		return BC6HDecoder::HalfToFloat(value);
+	}
+
+	template<>
+	inline uint16_t convertHalf(uint16_t value)
+	{
+		return value;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// BC6H decoder
+//--------------------------------------------------------------------------------------
+BC6HDecoder::BC6HDecoder(bool isSigned, uint32_t numThreads) :
+	m_threadPool(new ThreadPool(numThreads)),
+	m_isSigned(isSigned)
+{
+}
+
+BC6HDecoder::~BC6HDecoder()
+{
+}
+
+bool BC6HDecoder::Decode(float* const* ppDst, const Surface* pSrcs, uint32_t numSurfaces,
+	uint8_t texelStride, uint32_t dstRowPitch) const
+{
+	return decode(ppDst, pSrcs, numSurfaces, texelStride, dstRowPitch, 1.0f);
+}
+
+bool BC6HDecoder::Decode(uint16_t* const* ppDst, const Surface* pSrcs, uint32_t numSurfaces,
+	uint8_t texelStride, uint32_t dstRowPitch) const
+{
+	return decode(ppDst, pSrcs, numSurfaces, texelStride, dstRowPitch, static_cast<uint16_t>(0x3c00));
+}
+
+void BC6HDecoder::DecodeBlock(uint16_t texels[16][3], const uint8_t block[16], bool isSigned)
+{
+	BitReader bits(block);
+
+	// Mode
+	auto mode = bits.Read(2);
+	if (mode > 1) mode |= bits.Read(3) << 2;
+	const auto modeIdx = mode > 1 ? ModeIndices[mode] : mode;
+	if (modeIdx >= sizeof(ModeDescs) / sizeof(ModeDesc))
+	{
+		memset(texels, 0, sizeof(uint16_t[16][3]));
+		return;
+	}
+
+	// Header
+	const auto& desc = ModeDescs[modeIdx];
+	int32_t fields[D + 1] = {};
+	for (auto i = 0u; i < desc.NumRuns; ++i)
+	{
+		const auto& run = desc.Runs[i];
+		if (run.First <= run.Last) fields[run.Field] |= bits.Read(run.Last - run.First + 1) << run.First;
+		else for (auto b = run.First; b >= run.Last; --b) fields[run.Field] |= bits.Read(1) << b;
+	}
+
+	// Endpoints
+	const auto numEndpoints = desc.NumRegions * 2u;
+	const auto endpointMask = (1 << desc.EndpointBits) - 1;
+	int32_t endpoints[4][3];
+	for (auto c = 0u; c < 3; ++c)
+	{
+		const auto pFields = &fields[RW + 4 * c];
+		const auto base = isSigned ? signExtend(pFields[0], desc.EndpointBits) : pFields[0];
+		endpoints[0][c] = unquantize(base, desc.EndpointBits, isSigned);
+
+		for (auto e = 1u; e < numEndpoints; ++e)
+		{
+			auto value = pFields[e];
+			if (desc.Transformed)
+			{
+				value = (base + signExtend(value, desc.DeltaBits[c])) & endpointMask;
+				if (isSigned) value = signExtend(value, desc.EndpointBits);
+			}
+			else if (isSigned) value = signExtend(value, desc.EndpointBits);
+
+			endpoints[e][c] = unquantize(value, desc.EndpointBits, isSigned);
+		}
+	}
+
+	// Indices
+	int32_t weights[16];
+	uint32_t regions[16];
+	if (desc.NumRegions == 1)
+	{
+		bits.Seek(65);
+		for (auto i = 0u; i < 16; ++i)
+		{
+			weights[i] = Weights4[bits.Read(i == 0 ? 3 : 4)];
+			regions[i] = 0;
+		}
+	}
+	else
+	{
+		const auto partition = fields[D];
+		const auto anchor = Anchors[partition];
+		bits.Seek(82);
+		for (auto i = 0u; i < 16; ++i)
+		{
+			weights[i] = Weights3[bits.Read(i == 0 || i == anchor ? 2 : 3)];
+			regions[i] = (Partitions[partition] >> i) & 1;
+		}
+	}
+
+	// Interpolation
+	for (auto i = 0u; i < 16; ++i)
+	{
+		const auto e0 = endpoints[2 * regions[i]];
+		const auto e1 = endpoints[2 * regions[i] + 1];
+		const auto w = weights[i];
+		for (auto c = 0u; c < 3; ++c)
+			texels[i][c] = finishUnquantize(((64 - w) * e0[c] + w * e1[c] + 32) >> 6, isSigned);
+	}
+}
+
+float BC6HDecoder::HalfToFloat(uint16_t value)
+{
+	// Rebias the exponent with a multiply, which also handles the denormals;
+	// BC6H never produces infinities or NaNs.
+	const uint32_t bits = (value & 0x7fffu) << 13;
+	float result;
+	memcpy(&result, &bits, sizeof(float));
+	result *= 5.192296858534828e33f;	// 2^112
+
+	return (value & 0x8000) ? -result : result;
+}
+
+bool BC6HDecoder::IsSigned() const
+{
+	return m_isSigned;
+}
+
+template<typename T>
+bool BC6HDecoder::decode(T* const* ppDst, const Surface* pSrcs, uint32_t numSurfaces,
+	uint8_t texelStride, uint32_t dstRowPitch, T one) const
+{
+	if (!ppDst || !pSrcs || (texelStride != 3 && texelStride != 4)) return false;
+	for (auto i = 0u; i < numSurfaces; ++i)
+		if (!ppDst[i] || !pSrcs[i].pBlocks || pSrcs[i].Width == 0 || pSrcs[i].Height == 0) return false;
+
+	// Tasks are rows of blocks, numbered across all the surfaces
+	vector<uint32_t> taskOffsets(numSurfaces + 1, 0);
+	for (auto i = 0u; i < numSurfaces; ++i)
+		taskOffsets[i + 1] = taskOffsets[i] + (pSrcs[i].Height + 3) / 4;
+
+	const auto isSigned = m_isSigned;
+	m_threadPool->ParallelFor(taskOffsets[numSurfaces], [&](uint32_t task)
+	{
+		const auto surface = static_cast<uint32_t>(upper_bound(taskOffsets.cbegin(), taskOffsets.cend(), task) - taskOffsets.cbegin() - 1);
+		const auto& src = pSrcs[surface];
+		const auto blockY = task - taskOffsets[surface];
+		const auto numBlocksX = (src.Width + 3) / 4;
+		const auto srcRowPitch = src.RowPitch ? src.RowPitch : numBlocksX * 16;
+		const auto rowPitch = dstRowPitch ? dstRowPitch : src.Width * texelStride;
+		const auto pBlocks = &src.pBlocks[static_cast<size_t>(srcRowPitch) * blockY];
+		const auto height = (min)(src.Height - blockY * 4, 4u);
+
+		uint16_t texels[16][3];
+		for (auto blockX = 0u; blockX < numBlocksX; ++blockX)
+		{
+			DecodeBlock(texels, &pBlocks[16 * blockX], isSigned);
+
+			const auto width = (min)(src.Width - blockX * 4, 4u);
+			for (auto y = 0u; y < height; ++y)
+			{
+				auto pDst = &ppDst[surface][static_cast<size_t>(rowPitch) * (blockY * 4 + y) + texelStride * blockX * 4];
+				for (auto x = 0u; x < width; ++x)
+				{
+					const auto& texel = texels[y * 4 + x];
+					pDst[0] = convertHalf<T>(texel[0]);
+					pDst[1] = convertHalf<T>(texel[1]);
+					pDst[2] = convertHalf<T>(texel[2]);
+					if (texelStride > 3) pDst[3] = one;
+					pDst += texelStride;
+				}
+			}
+		}
+	});
+
+	return true;
+}
@@ -0,0 +1,51 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <memory>
+#include "XUSGThreadPool.h"
+
+namespace XUSG
+{
+	// CPU decoder of BC6H_UF16 and BC6H_SF16 blocks, so that the HDR environment maps
+	// can be consumed without a graphics device
+	class BC6HDecoder
+	{
+	public:
+		struct Surface
+		{
+			const uint8_t* pBlocks;	// 16-byte blocks, row-major
+			uint32_t Width;			// In texels
+			uint32_t Height;		// In texels
+			uint32_t RowPitch;		// In bytes per row of blocks, 0 for tightly packed rows
+		};
+
+		BC6HDecoder(bool isSigned = false, uint32_t numThreads = 0);
+		virtual ~BC6HDecoder();
+
+		// Decodes the surfaces into float or half texels with a stride of 3 (RGB) or 4 (RGBA),
+		// the row pitch is in elements, 0 for tightly packed rows. All surfaces are decoded
+		// in one parallel pass, e.g. the 6 faces of a cube map at the selected mip level.
+		bool Decode(float* const* ppDst, const Surface* pSrcs, uint32_t numSurfaces,
+			uint8_t texelStride = 3, uint32_t dstRowPitch = 0) const;
+		bool Decode(uint16_t* const* ppDst, const Surface* pSrcs, uint32_t numSurfaces,
+			uint8_t texelStride = 4, uint32_t dstRowPitch = 0) const;
+
+		// Writes the half-float RGB of the 4x4 texels, zeros for the reserved modes
+		static void DecodeBlock(uint16_t texels[16][3], const uint8_t block[16], bool isSigned);
+		static float HalfToFloat(uint16_t value);
+
+		bool IsSigned() const;
+
+	protected:
+		template<typename T>
+		bool decode(T* const* ppDst, const Surface* pSrcs, uint32_t numSurfaces,
+			uint8_t texelStride, uint32_t dstRowPitch, T one) const;
+
+		std::unique_ptr<ThreadPool> m_threadPool;
+
+		bool m_isSigned;
+	};
+}
@@ -0,0 +1,169 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "XUSGClusterCuller.h"
+
+using namespace std;
+using namespace XUSG;
+
+namespace
+{
+	enum Visibility : uint8_t
+	{
+		VISIBLE,
+		FRUSTUM_CULLED,
+		BACKFACE_CULLED
+	};
+
+	struct Plane
+	{
+		float N[3];
+		float D;
+	};
+
+	// Gribb-Hartmann planes of the D3D clip volume (0 <= z <= w), normalized
+	void extractFrustum(Plane planes[6], const float m[16])
+	{
+		const auto row = [m](uint8_t i) { return &m[i * 4]; };
+		for (uint8_t i = 0; i < 6; ++i)
+		{
+			const auto r = row(i >> 1);
+			const auto w = row(3);
+			const float sign = i & 1 ? -1.0f : 1.0f;
+			float p[4];
+			for (uint8_t j = 0; j < 4; ++j) p[j] = i == 4 ? r[j] : w[j] + sign * r[j];
+
+			const auto l = sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+			const auto s = l > 0.0f ? 1.0f / l : 0.0f;
+			planes[i] = { { p[0] * s, p[1] * s, p[2] * s }, p[3] * s };
+		}
+	}
+
+	inline Visibility testCluster(const MeshletBuilder::Bounds& bounds, const Plane planes[6], const float eyePt[3])
+	{
+		for (uint8_t i = 0; i < 6; ++i)
+		{
+			const auto& plane = planes[i];
+			const auto dist = plane.N[0] * bounds.Center[0] + plane.N[1] * bounds.Center[1] +
+				plane.N[2] * bounds.Center[2] + plane.D;
+			if (dist < -bounds.Radius) return FRUSTUM_CULLED;
+		}
+
+		const float v[] = { bounds.Center[0] - eyePt[0], bounds.Center[1] - eyePt[1], bounds.Center[2] - eyePt[2] };
+		const auto dist = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		const auto proj = v[0] * bounds.ConeAxis[0] + v[1] * bounds.ConeAxis[1] + v[2] * bounds.ConeAxis[2];
+
+		return proj >= bounds.ConeCutoff * dist + bounds.Radius ? BACKFACE_CULLED : VISIBLE;
+	}
+}
+
+const uint32_t ClusterCuller::ClustersPerTask;
+
+ClusterCuller::ClusterCuller(uint32_t numThreads) :
+	m_pMeshlets(nullptr),
+	m_threadPool(new ThreadPool(numThreads))
+{
+}
+
+ClusterCuller::~ClusterCuller()
+{
+}
+
+bool ClusterCuller::Init(const MeshletBuilder* pMeshlets)
+{
+	m_pMeshlets = pMeshlets;
+	if (!m_pMeshlets || !m_pMeshlets->GetMeshlets()) return false;
+
+	const auto numClusters = m_pMeshlets->GetNumMeshlets();
+	m_visibility.resize(numClusters);
+	m_taskOffsets.resize((numClusters + ClustersPerTask - 1) / ClustersPerTask + 1);
+
+	return true;
+}
+
+uint32_t ClusterCuller::Cull(uint32_t* pDst, const float worldViewProj[16], const float eyePt[3], Stats* pStats)
+{
+	const auto startTime = chrono::steady_clock::now();
+
+	const auto pMeshlets = m_pMeshlets->GetMeshlets();
+	const auto pBounds = m_pMeshlets->GetBounds();
+	const auto pVertexIndices = m_pMeshlets->GetUniqueVertexIndices();
+	const auto pPrimitives = m_pMeshlets->GetPrimitiveIndices();
+	const auto numClusters = m_pMeshlets->GetNumMeshlets();
+	const auto numTasks = static_cast<uint32_t>(m_taskOffsets.size()) - 1;
+
+	Plane planes[6];
+	extractFrustum(planes, worldViewProj);
+
+	// Test the clusters and count the surviving triangles of each task.
+	m_threadPool->ParallelFor(numTasks, [&](uint32_t task)
+	{
+		const auto begin = ClustersPerTask * task;
+		const auto end = (min)(begin + ClustersPerTask, numClusters);
+
+		auto numTriangles = 0u;
+		for (auto i = begin; i < end; ++i)
+		{
+			m_visibility[i] = testCluster(pBounds[i], planes, eyePt);
+			numTriangles += m_visibility[i] == VISIBLE ? pMeshlets[i].PrimitiveCount : 0;
+		}
+		m_taskOffsets[task + 1] = numTriangles;
+	});
+
+	m_taskOffsets[0] = 0;
+	for (auto i = 0u; i < numTasks; ++i) m_taskOffsets[i + 1] += m_taskOffsets[i];
+
+	// Expand the visible triangles in the cluster order, so that the output does not
+	// depend on the number of threads.
+	m_threadPool->ParallelFor(numTasks, [&](uint32_t task)
+	{
+		const auto begin = ClustersPerTask * task;
+		const auto end = (min)(begin + ClustersPerTask, numClusters);
+
+		auto pOut = &pDst[m_taskOffsets[task] * 3];
+		for (auto i = begin; i < end; ++i)
+		{
+			if (m_visibility[i] != VISIBLE) continue;
+
+			const auto& meshlet = pMeshlets[i];
+			const auto pLocalToGlobal = &pVertexIndices[meshlet.VertexOffset];
+			for (auto j = 0u; j < meshlet.PrimitiveCount; ++j)
+			{
+				uint32_t i0, i1, i2;
+				MeshletBuilder::UnpackPrimitive(pPrimitives[meshlet.PrimitiveOffset + j], i0, i1, i2);
+				pOut[0] = pLocalToGlobal[i0];
+				pOut[1] = pLocalToGlobal[i1];
+				pOut[2] = pLocalToGlobal[i2];
+				pOut += 3;
+			}
+		}
+	});
+
+	const auto numIndices = m_taskOffsets[numTasks] * 3;
+
+	if (pStats)
+	{
+		*pStats = {};
+		pStats->NumClusters = numClusters;
+		pStats->NumTriangles = m_pMeshlets->GetNumPrimitives();
+		pStats->NumVisibleTriangles = m_taskOffsets[numTasks];
+		for (const auto& visibility : m_visibility)
+		{
+			pStats->NumVisibleClusters += visibility == VISIBLE ? 1 : 0;
+			pStats->NumFrustumCulled += visibility == FRUSTUM_CULLED ? 1 : 0;
+			pStats->NumBackfaceCulled += visibility == BACKFACE_CULLED ? 1 : 0;
+		}
+		pStats->Milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+	}
+
+	return numIndices;
+}
+
+uint32_t ClusterCuller::GetMaxIndices() const
+{
+	return m_pMeshlets ? m_pMeshlets->GetNumPrimitives() * 3 : 0;
+}
@@ -0,0 +1,53 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <memory>
+#include "XUSGMeshletBuilder.h"
+#include "XUSGThreadPool.h"
+
+namespace XUSG
+{
+	// Per-frame CPU culling of meshlets against the view frustum and their normal cones,
+	// writing a compacted triangle-list index buffer of the surviving clusters
+	class ClusterCuller
+	{
+	public:
+		struct Stats
+		{
+			uint32_t NumClusters;
+			uint32_t NumVisibleClusters;
+			uint32_t NumFrustumCulled;		// Clusters
+			uint32_t NumBackfaceCulled;		// Clusters
+			uint32_t NumTriangles;
+			uint32_t NumVisibleTriangles;
+			double Milliseconds;			// Wall time of Cull()
+		};
+
+		ClusterCuller(uint32_t numThreads = 0);
+		virtual ~ClusterCuller();
+
+		// The meshlets are referenced, not copied
+		bool Init(const MeshletBuilder* pMeshlets);
+
+		// The matrix is row-major in the column-vector convention (clip = M * p), i.e. the
+		// transposed world-view-projection as stored in the constant buffers. The eye point
+		// is in the object space of the mesh. Writes up to GetMaxIndices() indices, and
+		// returns the number written.
+		uint32_t Cull(uint32_t* pDst, const float worldViewProj[16], const float eyePt[3],
+			Stats* pStats = nullptr);
+
+		uint32_t GetMaxIndices() const;
+
+	protected:
+		static const uint32_t ClustersPerTask = 64;
+
+		const MeshletBuilder* m_pMeshlets;
+		std::unique_ptr<ThreadPool> m_threadPool;
+
+		std::vector<uint8_t>	m_visibility;
+		std::vector<uint32_t>	m_taskOffsets;
+	};
+}
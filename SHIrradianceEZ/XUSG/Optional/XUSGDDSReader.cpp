@@ -0,0 +1,444 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstring>
+#include "XUSGDDSReader.h"
+
+using namespace std;
+using namespace XUSG;
+using namespace DDS;
+
+namespace
+{
+	const uint32_t DDSMagic = 0x20534444;	// "DDS "
+
+	const uint32_t DDSD_HEIGHT = 0x00000002;
+	const uint32_t DDSD_DEPTH = 0x00800000;
+	const uint32_t DDSCAPS2_CUBEMAP = 0x00000200;
+	const uint32_t DDSCAPS2_CUBEMAP_ALLFACES = 0x0000fc00;
+	const uint32_t DDSCAPS2_VOLUME = 0x00200000;
+
+	const uint32_t DDPF_ALPHA = 0x00000002;
+	const uint32_t DDPF_FOURCC = 0x00000004;
+	const uint32_t DDPF_RGB = 0x00000040;
+	const uint32_t DDPF_LUMINANCE = 0x00020000;
+
+	const uint32_t DDS_DIMENSION_TEXTURE1D = 2;
+	const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+	const uint32_t DDS_DIMENSION_TEXTURE3D = 4;
+	const uint32_t DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+	struct DDSPixelFormat
+	{
+		uint32_t Size;
+		uint32_t Flags;
+		uint32_t FourCC;
+		uint32_t RGBBitCount;
+		uint32_t RBitMask;
+		uint32_t GBitMask;
+		uint32_t BBitMask;
+		uint32_t ABitMask;
+	};
+
+	struct Header
+	{
+		uint32_t Size;
+		uint32_t Flags;
+		uint32_t Height;
+		uint32_t Width;
+		uint32_t PitchOrLinearSize;
+		uint32_t Depth;
+		uint32_t MipMapCount;
+		uint32_t Reserved1[11];
+		DDSPixelFormat PixelFormat;
+		uint32_t Caps;
+		uint32_t Caps2;
+		uint32_t Caps3;
+		uint32_t Caps4;
+		uint32_t Reserved2;
+	};
+
+	struct HeaderDXT10
+	{
+		uint32_t Format;
+		uint32_t ResourceDimension;
+		uint32_t MiscFlag;
+		uint32_t ArraySize;
+		uint32_t MiscFlags2;
+	};
+
+	constexpr uint32_t makeFourCC(char c0, char c1, char c2, char c3)
+	{
+		return static_cast<uint32_t>(c0) | (static_cast<uint32_t>(c1) << 8) |
+			(static_cast<uint32_t>(c2) << 16) | (static_cast<uint32_t>(c3) << 24);
+	}
+
+	inline bool isBitMask(const DDSPixelFormat& pf, uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+	{
+		return pf.RBitMask == r && pf.GBitMask == g && pf.BBitMask == b && pf.ABitMask == a;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// DDS reader
+//--------------------------------------------------------------------------------------
+Reader::Reader() :
+	m_format(DXGI_FORMAT_UNKNOWN),
+	m_width(0),
+	m_height(0),
+	m_depth(0),
+	m_mipLevels(0),
+	m_arraySize(0),
+	m_isCubeMap(false)
+{
+}
+
+Reader::~Reader()
+{
+}
+
+bool Reader::Open(const char* fileName)
+{
+	Close();
+	if (!m_file.Open(fileName)) return false;
+	if (parse(m_file.GetData(), m_file.GetSize())) return true;
+
+	Close();
+
+	return false;
+}
+
+bool Reader::Open(const uint8_t* pData, size_t size)
+{
+	Close();
+	if (parse(pData, size)) return true;
+
+	Close();
+
+	return false;
+}
+
+void Reader::Close()
+{
+	m_file.Close();
+	m_subresources.clear();
+	m_format = DXGI_FORMAT_UNKNOWN;
+	m_width = 0;
+	m_height = 0;
+	m_depth = 0;
+	m_mipLevels = 0;
+	m_arraySize = 0;
+	m_isCubeMap = false;
+}
+
+const Reader::Subresource* Reader::GetSubresource(uint32_t mipLevel, uint32_t arraySlice) const
+{
+	if (mipLevel >= m_mipLevels || arraySlice >= m_arraySize) return nullptr;
+
+	return &m_subresources[m_mipLevels * arraySlice + mipLevel];
+}
+
+DXGI_FORMAT Reader::GetFormat() const
+{
+	return m_format;
+}
+
+uint32_t Reader::GetWidth() const
+{
+	return m_width;
+}
+
+uint32_t Reader::GetHeight() const
+{
+	return m_height;
+}
+
+uint32_t Reader::GetDepth() const
+{
+	return m_depth;
+}
+
+uint32_t Reader::GetMipLevels() const
+{
+	return m_mipLevels;
+}
+
+uint32_t Reader::GetArraySize() const
+{
+	return m_arraySize;
+}
+
+bool Reader::IsCubeMap() const
+{
+	return m_isCubeMap;
+}
+
+bool Reader::GetElementInfo(DXGI_FORMAT format, uint32_t& bytesPerElement,
+	uint8_t& blockWidth, uint8_t& blockHeight)
+{
+	blockWidth = 1;
+	blockHeight = 1;
+
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_TYPELESS:
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_TYPELESS:
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC4_SNORM:
+		bytesPerElement = 8;
+		blockWidth = 4;
+		blockHeight = 4;
+		return true;
+	case DXGI_FORMAT_BC2_TYPELESS:
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_TYPELESS:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_TYPELESS:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC5_SNORM:
+	case DXGI_FORMAT_BC6H_TYPELESS:
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC6H_SF16:
+	case DXGI_FORMAT_BC7_TYPELESS:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		bytesPerElement = 16;
+		blockWidth = 4;
+		blockHeight = 4;
+		return true;
+	case DXGI_FORMAT_R8G8_B8G8_UNORM:
+	case DXGI_FORMAT_G8R8_G8B8_UNORM:
+		bytesPerElement = 4;
+		blockWidth = 2;
+		return true;
+	case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8X8_UNORM:
+	case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8X8_TYPELESS:
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+	case DXGI_FORMAT_AYUV:
+	case DXGI_FORMAT_Y410:
+		bytesPerElement = 4;
+		return true;
+	case DXGI_FORMAT_Y416:
+		bytesPerElement = 8;
+		return true;
+	case DXGI_FORMAT_B5G6R5_UNORM:
+	case DXGI_FORMAT_B5G5R5A1_UNORM:
+	case DXGI_FORMAT_B4G4R4A4_UNORM:
+	case DXGI_FORMAT_A4B4G4R4_UNORM:
+		bytesPerElement = 2;
+		return true;
+	default:
+		if (format >= DXGI_FORMAT_R32G32B32A32_TYPELESS && format <= DXGI_FORMAT_R32G32B32A32_SINT) bytesPerElement = 16;
+		else if (format >= DXGI_FORMAT_R32G32B32_TYPELESS && format <= DXGI_FORMAT_R32G32B32_SINT) bytesPerElement = 12;
+		else if (format >= DXGI_FORMAT_R16G16B16A16_TYPELESS && format <= DXGI_FORMAT_X32_TYPELESS_G8X24_UINT) bytesPerElement = 8;
+		else if (format >= DXGI_FORMAT_R10G10B10A2_TYPELESS && format <= DXGI_FORMAT_X24_TYPELESS_G8_UINT) bytesPerElement = 4;
+		else if (format >= DXGI_FORMAT_R8G8_TYPELESS && format <= DXGI_FORMAT_R16_SINT) bytesPerElement = 2;
+		else if (format >= DXGI_FORMAT_R8_TYPELESS && format <= DXGI_FORMAT_A8_UNORM) bytesPerElement = 1;
+		else return false;	// Planar, palettized and 1-bit formats are not supported
+		return true;
+	}
+}
+
+bool Reader::parse(const uint8_t* pData, size_t size)
+{
+	// Headers
+	if (!pData || size < sizeof(uint32_t) + sizeof(Header)) return false;
+
+	uint32_t magic;
+	memcpy(&magic, pData, sizeof(uint32_t));
+	if (magic != DDSMagic) return false;
+
+	Header header;
+	memcpy(&header, pData + sizeof(uint32_t), sizeof(Header));
+	if (header.Size != sizeof(Header) || header.PixelFormat.Size != sizeof(DDSPixelFormat)) return false;
+
+	auto offset = sizeof(uint32_t) + sizeof(Header);
+	m_width = header.Width;
+	m_height = header.Height;
+	m_depth = 1;
+	m_mipLevels = header.MipMapCount ? header.MipMapCount : 1;
+	m_arraySize = 1;
+
+	if ((header.PixelFormat.Flags & DDPF_FOURCC) && header.PixelFormat.FourCC == makeFourCC('D', 'X', '1', '0'))
+	{
+		if (size < offset + sizeof(HeaderDXT10)) return false;
+
+		HeaderDXT10 headerDXT10;
+		memcpy(&headerDXT10, pData + offset, sizeof(HeaderDXT10));
+		offset += sizeof(HeaderDXT10);
+
+		m_format = static_cast<DXGI_FORMAT>(headerDXT10.Format);
+		m_arraySize = headerDXT10.ArraySize;
+		if (m_arraySize == 0) return false;
+
+		switch (headerDXT10.ResourceDimension)
+		{
+		case DDS_DIMENSION_TEXTURE1D:
+			if ((header.Flags & DDSD_HEIGHT) && m_height != 1) return false;
+			m_height = 1;
+			break;
+		case DDS_DIMENSION_TEXTURE2D:
+			if (headerDXT10.MiscFlag & DDS_RESOURCE_MISC_TEXTURECUBE)
+			{
+				if (m_arraySize > UINT32_MAX / 6) return false;
+				m_arraySize *= 6;
+				m_isCubeMap = true;
+			}
+			break;
+		case DDS_DIMENSION_TEXTURE3D:
+			if (!(header.Flags & DDSD_DEPTH) || m_arraySize > 1) return false;
+			m_depth = header.Depth;
+			break;
+		default:
+			return false;
+		}
+	}
+	else
+	{
+		m_format = getLegacyFormat(reinterpret_cast<const uint8_t*>(&header.PixelFormat));
+
+		if (header.Flags & DDSD_DEPTH)
+		{
+			if (!(header.Caps2 & DDSCAPS2_VOLUME)) return false;
+			m_depth = header.Depth;
+		}
+		else if (header.Caps2 & DDSCAPS2_CUBEMAP)
+		{
+			// Partial cube maps are not supported
+			if ((header.Caps2 & DDSCAPS2_CUBEMAP_ALLFACES) != DDSCAPS2_CUBEMAP_ALLFACES) return false;
+			m_arraySize = 6;
+			m_isCubeMap = true;
+		}
+	}
+
+	// Validate the dimensions
+	uint32_t bytesPerElement;
+	uint8_t blockWidth, blockHeight;
+	if (!GetElementInfo(m_format, bytesPerElement, blockWidth, blockHeight)) return false;
+	if (m_width == 0 || m_height == 0 || m_depth == 0) return false;
+	if (m_isCubeMap && m_width != m_height) return false;
+
+	auto maxMipLevels = 1u;
+	for (auto maxSize = (max)((max)(m_width, m_height), m_depth); maxSize > 1; maxSize >>= 1) ++maxMipLevels;
+	if (m_mipLevels > maxMipLevels) return false;
+
+	// Mip layouts in 64 bits, then the total size against the file before any allocation
+	Subresource mips[32] = {};
+	uint64_t arraySliceSize = 0;
+	for (auto j = 0u; j < m_mipLevels; ++j)
+	{
+		auto& mip = mips[j];
+		mip.Width = (max)(m_width >> j, 1u);
+		mip.Height = (max)(m_height >> j, 1u);
+		mip.Depth = (max)(m_depth >> j, 1u);
+		mip.BlockWidth = blockWidth;
+		mip.BlockHeight = blockHeight;
+		mip.NumRows = (mip.Height + blockHeight - 1) / blockHeight;
+
+		const auto rowPitch = static_cast<uint64_t>((mip.Width + blockWidth - 1) / blockWidth) * bytesPerElement;
+		const auto slicePitch = rowPitch * mip.NumRows;
+		if (slicePitch > UINT32_MAX) return false;
+		mip.RowPitch = static_cast<uint32_t>(rowPitch);
+		mip.SlicePitch = static_cast<uint32_t>(slicePitch);
+
+		const auto mipSize = slicePitch * mip.Depth;
+		if (mipSize > size - offset) return false;
+		mip.Size = static_cast<size_t>(mipSize);
+		arraySliceSize += mipSize;
+	}
+	if (arraySliceSize > size - offset || m_arraySize > (size - offset) / arraySliceSize) return false;
+
+	// Subresource spans, array slice-major and then mip-major as in the file
+	m_subresources.resize(static_cast<size_t>(m_arraySize) * m_mipLevels);
+	for (auto i = 0u; i < m_arraySize; ++i)
+	{
+		for (auto j = 0u; j < m_mipLevels; ++j)
+		{
+			auto& subresource = m_subresources[m_mipLevels * i + j];
+			subresource = mips[j];
+			subresource.pData = pData + offset;
+			offset += subresource.Size;
+		}
+	}
+
+	return true;
+}
+
+DXGI_FORMAT Reader::getLegacyFormat(const uint8_t* pPixelFormat)
+{
+	DDSPixelFormat pf;
+	memcpy(&pf, pPixelFormat, sizeof(DDSPixelFormat));
+
+	if (pf.Flags & DDPF_RGB)
+	{
+		switch (pf.RGBBitCount)
+		{
+		case 32:
+			if (isBitMask(pf, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000)) return DXGI_FORMAT_R8G8B8A8_UNORM;
+			if (isBitMask(pf, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000)) return DXGI_FORMAT_B8G8R8A8_UNORM;
+			if (isBitMask(pf, 0x00ff0000, 0x0000ff00, 0x000000ff, 0x00000000)) return DXGI_FORMAT_B8G8R8X8_UNORM;
+			// D3DX writes the masks of 10:10:10:2 reversed; as in DirectXTex, the opposite masks
+			// (0x000003ff, 0x000ffc00, 0x3ff00000, 0xc0000000) are left unmapped
+			if (isBitMask(pf, 0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000)) return DXGI_FORMAT_R10G10B10A2_UNORM;
+			if (isBitMask(pf, 0x0000ffff, 0xffff0000, 0x00000000, 0x00000000)) return DXGI_FORMAT_R16G16_UNORM;
+			if (isBitMask(pf, 0xffffffff, 0x00000000, 0x00000000, 0x00000000)) return DXGI_FORMAT_R32_FLOAT;
+			break;
+		case 16:
+			if (isBitMask(pf, 0x7c00, 0x03e0, 0x001f, 0x8000)) return DXGI_FORMAT_B5G5R5A1_UNORM;
+			if (isBitMask(pf, 0xf800, 0x07e0, 0x001f, 0x0000)) return DXGI_FORMAT_B5G6R5_UNORM;
+			if (isBitMask(pf, 0x0f00, 0x00f0, 0x000f, 0xf000)) return DXGI_FORMAT_B4G4R4A4_UNORM;
+			break;
+		}
+	}
+	else if (pf.Flags & DDPF_LUMINANCE)
+	{
+		if (pf.RGBBitCount == 8 && isBitMask(pf, 0xff, 0, 0, 0)) return DXGI_FORMAT_R8_UNORM;
+		if (pf.RGBBitCount == 16 && isBitMask(pf, 0xffff, 0, 0, 0)) return DXGI_FORMAT_R16_UNORM;
+		if (pf.RGBBitCount == 16 && isBitMask(pf, 0x00ff, 0, 0, 0xff00)) return DXGI_FORMAT_R8G8_UNORM;
+	}
+	else if (pf.Flags & DDPF_ALPHA)
+	{
+		if (pf.RGBBitCount == 8) return DXGI_FORMAT_A8_UNORM;
+	}
+	else if (pf.Flags & DDPF_FOURCC)
+	{
+		switch (pf.FourCC)
+		{
+		case makeFourCC('D', 'X', 'T', '1'): return DXGI_FORMAT_BC1_UNORM;
+		case makeFourCC('D', 'X', 'T', '2'):
+		case makeFourCC('D', 'X', 'T', '3'): return DXGI_FORMAT_BC2_UNORM;
+		case makeFourCC('D', 'X', 'T', '4'):
+		case makeFourCC('D', 'X', 'T', '5'): return DXGI_FORMAT_BC3_UNORM;
+		case makeFourCC('A', 'T', 'I', '1'):
+		case makeFourCC('B', 'C', '4', 'U'): return DXGI_FORMAT_BC4_UNORM;
+		case makeFourCC('B', 'C', '4', 'S'): return DXGI_FORMAT_BC4_SNORM;
+		case makeFourCC('A', 'T', 'I', '2'):
+		case makeFourCC('B', 'C', '5', 'U'): return DXGI_FORMAT_BC5_UNORM;
+		case makeFourCC('B', 'C', '5', 'S'): return DXGI_FORMAT_BC5_SNORM;
+		case makeFourCC('R', 'G', 'B', 'G'): return DXGI_FORMAT_R8G8_B8G8_UNORM;
+		case makeFourCC('G', 'R', 'G', 'B'): return DXGI_FORMAT_G8R8_G8B8_UNORM;
+		// D3DFORMAT codes
+		case 36: return DXGI_FORMAT_R16G16B16A16_UNORM;
+		case 110: return DXGI_FORMAT_R16G16B16A16_SNORM;
+		case 111: return DXGI_FORMAT_R16_FLOAT;
+		case 112: return DXGI_FORMAT_R16G16_FLOAT;
+		case 113: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+		case 114: return DXGI_FORMAT_R32_FLOAT;
+		case 115: return DXGI_FORMAT_R32G32_FLOAT;
+		case 116: return DXGI_FORMAT_R32G32B32A32_FLOAT;
+		}
+	}
+
+	return DXGI_FORMAT_UNKNOWN;
+}
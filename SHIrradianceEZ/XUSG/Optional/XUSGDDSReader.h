@@ -0,0 +1,73 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+#include "dxgiformat.h"
+#include "XUSGMappedFile.h"
+
+namespace XUSG
+{
+	namespace DDS
+	{
+		// Zero-copy DDS container parser, independent of any graphics device. The spans
+		// point into the mapped file (or the memory given to Open()).
+		class Reader
+		{
+		public:
+			struct Subresource
+			{
+				const uint8_t* pData;
+				size_t Size;			// In bytes, all depth slices
+				uint32_t Width;			// In texels
+				uint32_t Height;		// In texels
+				uint32_t Depth;			// In texels
+				uint32_t RowPitch;		// In bytes per row of blocks
+				uint32_t SlicePitch;	// In bytes per depth slice
+				uint32_t NumRows;		// Rows of blocks
+				uint8_t BlockWidth;		// 4 for block compression, 1 or 2 otherwise
+				uint8_t BlockHeight;	// 4 for block compression, 1 otherwise
+			};
+
+			Reader();
+			virtual ~Reader();
+
+			bool Open(const char* fileName);
+			bool Open(const uint8_t* pData, size_t size);
+			void Close();
+
+			// The array slice of a cube map is arrayIndex * 6 + face
+			const Subresource* GetSubresource(uint32_t mipLevel, uint32_t arraySlice = 0) const;
+
+			DXGI_FORMAT GetFormat() const;
+			uint32_t GetWidth() const;
+			uint32_t GetHeight() const;
+			uint32_t GetDepth() const;
+			uint32_t GetMipLevels() const;
+			uint32_t GetArraySize() const;	// Including the 6 faces of cube maps
+			bool IsCubeMap() const;
+
+			// Bytes per block and block size, false for unsupported formats
+			static bool GetElementInfo(DXGI_FORMAT format, uint32_t& bytesPerElement,
+				uint8_t& blockWidth, uint8_t& blockHeight);
+
+		protected:
+			bool parse(const uint8_t* pData, size_t size);
+
+			static DXGI_FORMAT getLegacyFormat(const uint8_t* pPixelFormat);
+
+			MappedFile	m_file;
+			std::vector<Subresource> m_subresources;
+
+			DXGI_FORMAT	m_format;
+			uint32_t	m_width;
+			uint32_t	m_height;
+			uint32_t	m_depth;
+			uint32_t	m_mipLevels;
+			uint32_t	m_arraySize;
+			bool		m_isCubeMap;
+		};
+	}
+}
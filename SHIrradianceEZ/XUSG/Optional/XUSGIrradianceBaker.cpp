@@ -0,0 +1,136 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include "XUSGIrradianceBaker.h"
+
+using namespace std;
+using namespace XUSG;
+
+namespace
+{
+	SH::float3 evaluateL2(const SH::float3 shCoeffs[9], const SH::float3& norm,
+		float c1, float c2, float c3, float c4)
+	{
+		const auto x = -norm.x;
+		const auto y = -norm.y;
+		const auto z = norm.z;
+
+		float irradiance[3];
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			const auto L = [shCoeffs, i](uint8_t k) { return (&shCoeffs[k].x)[i]; };
+			irradiance[i] = (max)(0.0f,
+				(c1 * (x * x - y * y)) * L(8)
+				+ (c3 * (3.0f * z * z - 1.0f)) * L(6)
+				+ c4 * L(0)
+				+ 2.0f * c1 * (L(4) * x * y + L(7) * x * z + L(5) * y * z)
+				+ 2.0f * c2 * (L(3) * x + L(1) * y + L(2) * z));
+		}
+
+		return SH::float3(irradiance);
+	}
+}
+
+const uint32_t IrradianceBaker::DirsPerTask;
+const uint32_t IrradianceBaker::BatchSize;
+
+IrradianceBaker::IrradianceBaker(uint32_t numThreads) :
+	m_threadPool(new ThreadPool(numThreads)),
+	m_coeffs(),
+	m_order(0),
+	m_isPolyL2(false),
+	m_simdLevel(SH::GetSIMDLevel())
+{
+}
+
+IrradianceBaker::~IrradianceBaker()
+{
+}
+
+bool IrradianceBaker::SetCoefficients(uint8_t order, const SH::float3* pCoeffs, Lobe lobe, SH::Window window)
+{
+	if (!pCoeffs || order < 2 || order > SH_MAX_ORDER) return false;
+
+	m_isPolyL2 = order == 3 && window == SH::WINDOW_NONE;
+	if (lobe == LOBE_HAIR && !m_isPolyL2) return false;
+
+	if (m_isPolyL2) SH::SHFoldIrradianceL2(m_coeffs, pCoeffs, lobe == LOBE_HAIR);
+	else SH::SHConvolveIrradiance(m_coeffs, order, pCoeffs, window);
+	m_order = order;
+
+	return true;
+}
+
+void IrradianceBaker::SetSIMDLevel(SH::SIMDLevel simdLevel)
+{
+	m_simdLevel = (min)(simdLevel, SH::GetSIMDLevel());
+}
+
+void IrradianceBaker::Evaluate(float* pResult, size_t resultPitch, const float* pX, const float* pY,
+	const float* pZ, uint32_t numDirs)
+{
+	const auto numTasks = (numDirs + DirsPerTask - 1) / DirsPerTask;
+	m_threadPool->ParallelFor(numTasks, [&](uint32_t task)
+	{
+		const auto begin = DirsPerTask * task;
+		const auto n = (min)(DirsPerTask, numDirs - begin);
+		evaluate(&pResult[begin], resultPitch, &pX[begin], &pY[begin], &pZ[begin], n);
+	});
+}
+
+void IrradianceBaker::BakeVertices(SH::float3* pResult, const uint8_t* pVertices, uint32_t stride,
+	uint32_t normalOffset, uint32_t numVertices)
+{
+	const auto numTasks = (numVertices + DirsPerTask - 1) / DirsPerTask;
+	m_threadPool->ParallelFor(numTasks, [&](uint32_t task)
+	{
+		const auto end = (min)(DirsPerTask * (task + 1), numVertices);
+
+		// Transpose the normals into SoA batches, and the results back
+		float x[BatchSize], y[BatchSize], z[BatchSize], irradiance[BatchSize * 3];
+		for (auto i = DirsPerTask * task; i < end; i += BatchSize)
+		{
+			const auto n = (min)(BatchSize, end - i);
+			for (auto j = 0u; j < n; ++j)
+			{
+				const auto pNorm = reinterpret_cast<const float*>(&pVertices[stride * (i + j) + normalOffset]);
+				x[j] = pNorm[0];
+				y[j] = pNorm[1];
+				z[j] = pNorm[2];
+			}
+
+			evaluate(irradiance, BatchSize, x, y, z, n);
+			for (auto j = 0u; j < n; ++j)
+				pResult[i + j] = SH::float3(irradiance[j], irradiance[BatchSize + j], irradiance[BatchSize * 2 + j]);
+		}
+	});
+}
+
+SH::float3 IrradianceBaker::EvaluateSHIrradiance(const SH::float3 coeffs[9], const SH::float3& norm)
+{
+	const auto c1 = 0.42904276540489171563379376569857f;	// 4 * A2 * Y22 = 1/16 * sqrt(15PI)
+	const auto c2 = 0.51166335397324424423977581244463f;	// 1/2 * A1 * Y10 = 1/2 * sqrt(PI/3)
+	const auto c3 = 0.24770795610037568833406429782001f;	// A2 * Y20 = 1/16 * sqrt(5PI)
+	const auto c4 = 0.88622692545275801364908374167057f;	// A0 * Y00 = 1/2 * sqrt(PI)
+
+	return evaluateL2(coeffs, norm, c1, c2, c3, c4);
+}
+
+SH::float3 IrradianceBaker::EvaluateHairSHIrradiance(const SH::float3 coeffs[9], const SH::float3& tan)
+{
+	const auto c1 = 0.67393879993592845307140549769869f;	// PI/32 * sqrt(15PI)
+	const auto c2 = 0.80371891697672903141037740805026f;	// PI/4 * sqrt(PI/3)
+	const auto c3 = 0.38909874756034163531575854238775f;	// PI/32 * sqrt(5PI)
+	const auto c4 = 1.3920819992079269613212044955297f;		// PI/4 * sqrt(PI)
+
+	return evaluateL2(coeffs, tan, c1, c2, c3, c4);
+}
+
+void IrradianceBaker::evaluate(float* pResult, size_t resultPitch, const float* pX, const float* pY,
+	const float* pZ, uint32_t numDirs) const
+{
+	if (m_isPolyL2) SH::SHEvalIrradianceL2(pResult, resultPitch, m_coeffs, pX, pY, pZ, numDirs, m_simdLevel);
+	else SH::SHEvalIrradiance(pResult, resultPitch, m_order, m_coeffs, pX, pY, pZ, numDirs, m_simdLevel);
+}
@@ -0,0 +1,59 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <memory>
+#include "XUSGSHMath.h"
+#include "XUSGThreadPool.h"
+
+namespace XUSG
+{
+	// Parallel batch evaluation of irradiance from SH coefficients in the layout of the SH
+	// buffers of the shaders, e.g. for baking per-vertex irradiance offline
+	class IrradianceBaker
+	{
+	public:
+		enum Lobe : uint8_t
+		{
+			LOBE_COSINE,	// EvaluateSHIrradiance(), by normals
+			LOBE_HAIR		// EvaluateHairSHIrradiance(), by tangents
+		};
+
+		IrradianceBaker(uint32_t numThreads = 0);
+		virtual ~IrradianceBaker();
+
+		// Order 3 without a window uses the 9-term polynomial of the shaders, and the other
+		// orders or windows SH::SHConvolveIrradiance(). The hair lobe needs order 3 without
+		// a window.
+		bool SetCoefficients(uint8_t order, const SH::float3* pCoeffs, Lobe lobe = LOBE_COSINE,
+			SH::Window window = SH::WINDOW_NONE);
+		void SetSIMDLevel(SH::SIMDLevel simdLevel);
+
+		// SoA unit directions to SoA irradiance, with the SH::SHEvalIrradiance() layout
+		void Evaluate(float* pResult, size_t resultPitch, const float* pX, const float* pY,
+			const float* pZ, uint32_t numDirs);
+		// Interleaved vertices with a unit normal at normalOffset bytes, to a float3 per vertex
+		void BakeVertices(SH::float3* pResult, const uint8_t* pVertices, uint32_t stride,
+			uint32_t normalOffset, uint32_t numVertices);
+
+		// Scalar ports of XUSG/Shaders/SHIrradianceTypeless.hlsli
+		static SH::float3 EvaluateSHIrradiance(const SH::float3 coeffs[9], const SH::float3& norm);
+		static SH::float3 EvaluateHairSHIrradiance(const SH::float3 coeffs[9], const SH::float3& tan);
+
+	protected:
+		static const uint32_t DirsPerTask = 1 << 14;
+		static const uint32_t BatchSize = 256;
+
+		void evaluate(float* pResult, size_t resultPitch, const float* pX, const float* pY,
+			const float* pZ, uint32_t numDirs) const;
+
+		std::unique_ptr<ThreadPool> m_threadPool;
+
+		SH::float3		m_coeffs[SH::MaxCoeffCount];	// Folded polynomial or convolved coefficients
+		uint8_t			m_order;
+		bool			m_isPolyL2;
+		SH::SIMDLevel	m_simdLevel;
+	};
+}
@@ -0,0 +1,227 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include "XUSGIrradianceMap.h"
+
+using namespace std;
+using namespace XUSG;
+
+namespace
+{
+	const float InvPi = 0.318309886183790671538f;
+
+	inline float signNotZero(float v)
+	{
+		return v >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	// Inverse of SH::GetCubeTexcoord(): the face and the face-local (x, y) over the major axis
+	uint8_t getCubeFace(float& x, float& y, const SH::float3& dir)
+	{
+		const auto ax = fabs(dir.x);
+		const auto ay = fabs(dir.y);
+		const auto az = fabs(dir.z);
+
+		uint8_t slice;
+		float ma;
+		if (ax >= ay && ax >= az)
+		{
+			slice = dir.x >= 0.0f ? 0 : 1;
+			x = dir.x >= 0.0f ? -dir.z : dir.z;
+			y = dir.y;
+			ma = ax;
+		}
+		else if (ay >= az)
+		{
+			slice = dir.y >= 0.0f ? 2 : 3;
+			x = dir.x;
+			y = dir.y >= 0.0f ? -dir.z : dir.z;
+			ma = ay;
+		}
+		else
+		{
+			slice = dir.z >= 0.0f ? 4 : 5;
+			x = dir.z >= 0.0f ? dir.x : -dir.x;
+			y = dir.y;
+			ma = az;
+		}
+
+		x /= ma;
+		y /= ma;
+
+		return slice;
+	}
+}
+
+IrradianceMapGenerator::IrradianceMapGenerator(uint32_t numThreads) :
+	m_baker(new IrradianceBaker(numThreads)),
+	m_size(0),
+	m_layout(LAYOUT_CUBE)
+{
+}
+
+IrradianceMapGenerator::~IrradianceMapGenerator()
+{
+}
+
+bool IrradianceMapGenerator::Generate(Layout layout, uint32_t size, uint8_t order,
+	const SH::float3* pCoeffs, SH::Window window)
+{
+	if (size == 0) return false;
+	if (!m_baker->SetCoefficients(order, pCoeffs, IrradianceBaker::LOBE_COSINE, window)) return false;
+
+	m_size = size;
+	m_layout = layout;
+	const auto numSlices = layout == LAYOUT_CUBE ? 6u : 1u;
+	const auto numTexels = size * size * numSlices;
+
+	// Texel-center directions
+	m_dirs.resize(numTexels * 3);
+	const auto pX = m_dirs.data();
+	const auto pY = &pX[numTexels];
+	const auto pZ = &pY[numTexels];
+	for (auto s = 0u; s < numSlices; ++s)
+	{
+		for (auto y = 0u; y < size; ++y)
+		{
+			for (auto x = 0u; x < size; ++x)
+			{
+				SH::float3 dir;
+				if (layout == LAYOUT_CUBE)
+				{
+					dir = SH::GetCubeTexcoord(x, y, static_cast<uint8_t>(s), size);
+					const auto l = sqrt(dir.x * dir.x + dir.y * dir.y + dir.z * dir.z);
+					dir = SH::float3(dir.x / l, dir.y / l, dir.z / l);
+				}
+				else dir = DecodeOctahedral((x + 0.5f) / size, (y + 0.5f) / size);
+
+				const auto i = (s * size + y) * size + x;
+				pX[i] = dir.x;
+				pY[i] = dir.y;
+				pZ[i] = dir.z;
+			}
+		}
+	}
+
+	m_irradiance.resize(numTexels * 3);
+	m_baker->Evaluate(m_irradiance.data(), numTexels, pX, pY, pZ, numTexels);
+
+	// Interleave to RGBA, divided by pi for the shader
+	m_texels.resize(numTexels * 4);
+	for (auto i = 0u; i < numTexels; ++i)
+	{
+		m_texels[4 * i] = m_irradiance[i] * InvPi;
+		m_texels[4 * i + 1] = m_irradiance[numTexels + i] * InvPi;
+		m_texels[4 * i + 2] = m_irradiance[numTexels * 2 + i] * InvPi;
+		m_texels[4 * i + 3] = 1.0f;
+	}
+
+	return true;
+}
+
+const float* IrradianceMapGenerator::GetTexels() const
+{
+	return m_texels.data();
+}
+
+uint32_t IrradianceMapGenerator::GetNumTexels() const
+{
+	return static_cast<uint32_t>(m_texels.size() / 4);
+}
+
+uint32_t IrradianceMapGenerator::GetSize() const
+{
+	return m_size;
+}
+
+IrradianceMapGenerator::Layout IrradianceMapGenerator::GetLayout() const
+{
+	return m_layout;
+}
+
+SH::float3 IrradianceMapGenerator::Sample(const SH::float3& dir) const
+{
+	if (m_texels.empty()) return SH::float3(0.0f, 0.0f, 0.0f);
+
+	// Continuous texel coordinates, where texel centers are at integers
+	uint8_t slice = 0;
+	float tx, ty;
+	if (m_layout == LAYOUT_CUBE)
+	{
+		float x, y;
+		slice = getCubeFace(x, y, dir);
+		const auto radius = m_size * 0.5f;
+		tx = x * radius + radius - 0.5f;
+		ty = radius - 0.5f - y * radius;
+	}
+	else
+	{
+		float uv[2];
+		EncodeOctahedral(uv, dir);
+		tx = uv[0] * m_size - 0.5f;
+		ty = uv[1] * m_size - 0.5f;
+	}
+
+	const auto x0 = static_cast<int32_t>(floor(tx));
+	const auto y0 = static_cast<int32_t>(floor(ty));
+	const auto fx = tx - x0;
+	const auto fy = ty - y0;
+
+	const auto c00 = fetch(slice, x0, y0);
+	const auto c10 = fetch(slice, x0 + 1, y0);
+	const auto c01 = fetch(slice, x0, y0 + 1);
+	const auto c11 = fetch(slice, x0 + 1, y0 + 1);
+	const auto lerp2 = [fx, fy](float a, float b, float c, float d)
+	{
+		return (a + (b - a) * fx) * (1.0f - fy) + (c + (d - c) * fx) * fy;
+	};
+
+	return SH::float3(lerp2(c00.x, c10.x, c01.x, c11.x), lerp2(c00.y, c10.y, c01.y, c11.y),
+		lerp2(c00.z, c10.z, c01.z, c11.z));
+}
+
+void IrradianceMapGenerator::EncodeOctahedral(float uv[2], const SH::float3& dir)
+{
+	const auto l1 = fabs(dir.x) + fabs(dir.y) + fabs(dir.z);
+	auto x = l1 > 0.0f ? dir.x / l1 : 0.0f;
+	auto y = l1 > 0.0f ? dir.y / l1 : 0.0f;
+	if (dir.z < 0.0f)
+	{
+		const auto tx = (1.0f - fabs(y)) * signNotZero(x);
+		y = (1.0f - fabs(x)) * signNotZero(y);
+		x = tx;
+	}
+
+	uv[0] = x * 0.5f + 0.5f;
+	uv[1] = y * 0.5f + 0.5f;
+}
+
+SH::float3 IrradianceMapGenerator::DecodeOctahedral(float u, float v)
+{
+	auto x = u * 2.0f - 1.0f;
+	auto y = v * 2.0f - 1.0f;
+	const auto z = 1.0f - fabs(x) - fabs(y);
+
+	const auto t = (max)(-z, 0.0f);
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+
+	const auto l = sqrt(x * x + y * y + z * z);
+
+	return SH::float3(x / l, y / l, z / l);
+}
+
+SH::float3 IrradianceMapGenerator::fetch(uint8_t slice, int32_t x, int32_t y) const
+{
+	// Clamp addressing
+	const auto maxCoord = static_cast<int32_t>(m_size) - 1;
+	x = (min)((max)(x, 0), maxCoord);
+	y = (min)((max)(y, 0), maxCoord);
+
+	const auto pTexel = &m_texels[4 * ((slice * m_size + y) * m_size + x)];
+
+	return SH::float3(pTexel);
+}
@@ -0,0 +1,55 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "XUSGIrradianceBaker.h"
+
+namespace XUSG
+{
+	// Rasterizes the irradiance of SH coefficients into a small map, so that shading can
+	// replace the per-pixel SH evaluation with one filtered fetch. Texels store irradiance
+	// / pi as RGBA32F, which is what g_txIrradiance in Content/Shaders/PSBasePass.hlsl
+	// expects.
+	class IrradianceMapGenerator
+	{
+	public:
+		enum Layout : uint8_t
+		{
+			LAYOUT_CUBE,		// 6 consecutive slices of a TextureCube, faces as SH::GetCubeTexcoord()
+			LAYOUT_OCTAHEDRAL	// Texture2D, addressed by EncodeOctahedral()
+		};
+
+		IrradianceMapGenerator(uint32_t numThreads = 0);
+		virtual ~IrradianceMapGenerator();
+
+		// size is the face or map width in texels
+		bool Generate(Layout layout, uint32_t size, uint8_t order, const SH::float3* pCoeffs,
+			SH::Window window = SH::WINDOW_NONE);
+
+		const float* GetTexels() const;
+		uint32_t GetNumTexels() const;
+		uint32_t GetSize() const;
+		Layout GetLayout() const;
+
+		// Bilinear lookup within the face or map, as the texture fetch of the shader
+		SH::float3 Sample(const SH::float3& dir) const;
+
+		// Octahedral map with uv = p * 0.5 + 0.5, where p is the direction projected on
+		// |x| + |y| + |z| = 1, and the lower hemisphere folded out
+		static void EncodeOctahedral(float uv[2], const SH::float3& dir);
+		static SH::float3 DecodeOctahedral(float u, float v);
+
+	protected:
+		SH::float3 fetch(uint8_t slice, int32_t x, int32_t y) const;
+
+		std::unique_ptr<IrradianceBaker> m_baker;
+
+		std::vector<float>	m_texels;
+		std::vector<float>	m_dirs;		// SoA x, y, z planes
+		std::vector<float>	m_irradiance;
+		uint32_t			m_size;
+		Layout				m_layout;
+	};
+}
@@ -0,0 +1,132 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "XUSGMappedFile.h"
+
+using namespace XUSG;
+
+MappedFile::MappedFile() :
+	m_pData(nullptr),
+	m_size(0),
+	m_modifiedTime(0),
+#ifdef _WIN32
+	m_hFile(INVALID_HANDLE_VALUE),
+	m_hMapping(nullptr)
+#else
+	m_fd(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const char* fileName)
+{
+	Close();
+
+#ifdef _WIN32
+	m_hFile = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_hFile == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_hFile, &fileSize) || fileSize.QuadPart <= 0)
+	{
+		Close();
+		return false;
+	}
+	m_size = static_cast<size_t>(fileSize.QuadPart);
+
+	FILETIME lastWriteTime;
+	if (GetFileTime(m_hFile, nullptr, nullptr, &lastWriteTime))
+		m_modifiedTime = (static_cast<uint64_t>(lastWriteTime.dwHighDateTime) << 32) | lastWriteTime.dwLowDateTime;
+
+	m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_hMapping)
+	{
+		Close();
+		return false;
+	}
+
+	m_pData = static_cast<const uint8_t*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	m_fd = open(fileName, O_RDONLY);
+	if (m_fd < 0) return false;
+
+	struct stat fileStat;
+	if (fstat(m_fd, &fileStat) != 0 || fileStat.st_size <= 0)
+	{
+		Close();
+		return false;
+	}
+	m_size = static_cast<size_t>(fileStat.st_size);
+
+	// Nanoseconds, since edits within the same second may keep the size
+#ifdef __APPLE__
+	const auto& modifiedTime = fileStat.st_mtimespec;
+#else
+	const auto& modifiedTime = fileStat.st_mtim;
+#endif
+	m_modifiedTime = static_cast<uint64_t>(modifiedTime.tv_sec) * 1000000000 + static_cast<uint64_t>(modifiedTime.tv_nsec);
+
+	const auto pData = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+	m_pData = pData != MAP_FAILED ? static_cast<const uint8_t*>(pData) : nullptr;
+#endif
+
+	if (!m_pData)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (m_pData) UnmapViewOfFile(m_pData);
+	if (m_hMapping) CloseHandle(m_hMapping);
+	if (m_hFile != INVALID_HANDLE_VALUE) CloseHandle(m_hFile);
+	m_hMapping = nullptr;
+	m_hFile = INVALID_HANDLE_VALUE;
+#else
+	if (m_pData) munmap(const_cast<uint8_t*>(m_pData), m_size);
+	if (m_fd >= 0) close(m_fd);
+	m_fd = -1;
+#endif
+
+	m_pData = nullptr;
+	m_size = 0;
+	m_modifiedTime = 0;
+}
+
+const uint8_t* MappedFile::GetData() const
+{
+	return m_pData;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return m_size;
+}
+
+uint64_t MappedFile::GetModifiedTime() const
+{
+	return m_modifiedTime;
+}
@@ -0,0 +1,38 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace XUSG
+{
+	// Read-only memory-mapped file, so that consumers can read the contents without copying
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		virtual ~MappedFile();
+
+		bool Open(const char* fileName);
+		void Close();
+
+		const uint8_t* GetData() const;
+		size_t GetSize() const;
+		uint64_t GetModifiedTime() const;	// Platform-specific units, for staleness checks only
+
+	protected:
+		const uint8_t* m_pData;
+		size_t m_size;
+		uint64_t m_modifiedTime;
+
+#ifdef _WIN32
+		void* m_hFile;
+		void* m_hMapping;
+#else
+		int m_fd;
+#endif
+	};
+}
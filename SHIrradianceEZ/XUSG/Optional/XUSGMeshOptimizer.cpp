@@ -0,0 +1,276 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "XUSGMeshOptimizer.h"
+
+using namespace std;
+using namespace XUSG;
+
+namespace
+{
+	// Scoring constants of Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+	const float CacheDecayPower = 1.5f;
+	const float LastTriScore = 0.75f;
+	const float ValenceBoostScale = 2.0f;
+	const float ValenceBoostPower = 0.5f;
+	const uint32_t MaxValenceScores = 64;
+
+	uint32_t hashVertex(const uint8_t* pVertex, uint32_t stride)
+	{
+		// FNV-1a over 32-bit words, the stride is a multiple of 4 bytes
+		auto hash = 2166136261u;
+		for (auto i = 0u; i < stride; i += sizeof(uint32_t))
+		{
+			uint32_t word;
+			memcpy(&word, &pVertex[i], sizeof(uint32_t));
+			hash = (hash ^ word) * 16777619u;
+		}
+
+		return hash ^ (hash >> 16);
+	}
+}
+
+MeshOptimizer::MeshOptimizer(uint32_t cacheSize) :
+	m_cacheSize((max)(cacheSize, 4u))
+{
+	m_cacheScores.resize(m_cacheSize);
+	for (auto i = 0u; i < m_cacheSize; ++i)
+	{
+		// The vertices of the last triangle get a fixed score, so that the same
+		// triangle is not picked up again through its own vertices
+		const auto scaler = 1.0f / (m_cacheSize - 3);
+		m_cacheScores[i] = i < 3 ? LastTriScore : powf(1.0f - (i - 3) * scaler, CacheDecayPower);
+	}
+
+	m_valenceScores.resize(MaxValenceScores);
+	m_valenceScores[0] = 0.0f;
+	for (auto i = 1u; i < MaxValenceScores; ++i)
+		m_valenceScores[i] = ValenceBoostScale * powf(static_cast<float>(i), -ValenceBoostPower);
+}
+
+MeshOptimizer::~MeshOptimizer()
+{
+}
+
+void MeshOptimizer::Optimize(vector<uint8_t>& vertices, vector<uint32_t>& indices, uint32_t stride,
+	Stats* pBefore, Stats* pAfter) const
+{
+	const auto numIndices = static_cast<uint32_t>(indices.size());
+	if (pBefore) *pBefore = Analyze(indices.data(), numIndices, static_cast<uint32_t>(vertices.size() / stride));
+
+	const auto numVert = WeldVertices(vertices, indices, stride);
+	ReorderTriangles(indices.data(), numIndices, numVert);
+	const auto numUsed = ReorderVertices(vertices, indices, stride);
+
+	if (pAfter) *pAfter = Analyze(indices.data(), numIndices, numUsed);
+}
+
+uint32_t MeshOptimizer::WeldVertices(vector<uint8_t>& vertices, vector<uint32_t>& indices, uint32_t stride) const
+{
+	const auto numVert = static_cast<uint32_t>(vertices.size() / stride);
+
+	// Open-addressing table of the unique vertices, which are compacted in place
+	auto tableSize = 16u;
+	while (tableSize < numVert * 2) tableSize <<= 1;
+	vector<uint32_t> table(tableSize, UINT32_MAX);
+	vector<uint32_t> remap(numVert);
+
+	auto numUnique = 0u;
+	for (auto i = 0u; i < numVert; ++i)
+	{
+		const auto pVertex = &vertices[stride * i];
+		auto slot = hashVertex(pVertex, stride) & (tableSize - 1);
+		while (table[slot] != UINT32_MAX && memcmp(&vertices[stride * table[slot]], pVertex, stride) != 0)
+			slot = (slot + 1) & (tableSize - 1);
+
+		if (table[slot] == UINT32_MAX)
+		{
+			if (numUnique != i) memcpy(&vertices[stride * numUnique], pVertex, stride);
+			table[slot] = numUnique++;
+		}
+		remap[i] = table[slot];
+	}
+
+	for (auto& index : indices) index = remap[index];
+	vertices.resize(stride * numUnique);
+
+	return numUnique;
+}
+
+void MeshOptimizer::ReorderTriangles(uint32_t* pIndices, uint32_t numIndices, uint32_t numVertices) const
+{
+	const auto numTri = numIndices / 3;
+	if (numTri == 0) return;
+
+	// Build the vertex-triangle adjacency. The first numRemaining[v] entries of the list of
+	// vertex v are its triangles that have not been emitted.
+	vector<uint32_t> numRemaining(numVertices);
+	for (auto i = 0u; i < numTri * 3; ++i) ++numRemaining[pIndices[i]];
+
+	vector<uint32_t> adjOffsets(numVertices + 1);
+	for (auto i = 0u; i < numVertices; ++i) adjOffsets[i + 1] = adjOffsets[i] + numRemaining[i];
+
+	vector<uint32_t> adjacency(numTri * 3);
+	{
+		vector<uint32_t> cursors(adjOffsets.cbegin(), adjOffsets.cend() - 1);
+		for (auto i = 0u; i < numTri * 3; ++i) adjacency[cursors[pIndices[i]]++] = i / 3;
+	}
+
+	// Initial scores
+	vector<int32_t> cachePos(numVertices, -1);
+	vector<float> vertexScores(numVertices);
+	for (auto i = 0u; i < numVertices; ++i) vertexScores[i] = getVertexScore(-1, numRemaining[i]);
+
+	vector<float> triScores(numTri);
+	auto bestTri = 0u;
+	for (auto i = 0u; i < numTri; ++i)
+	{
+		const auto pTri = &pIndices[i * 3];
+		triScores[i] = vertexScores[pTri[0]] + vertexScores[pTri[1]] + vertexScores[pTri[2]];
+		bestTri = triScores[i] > triScores[bestTri] ? i : bestTri;
+	}
+
+	const vector<uint32_t> srcIndices(pIndices, pIndices + numTri * 3);
+	vector<uint8_t> isEmitted(numTri);
+	vector<uint32_t> cache, newCache;
+	cache.reserve(m_cacheSize + 3);
+	newCache.reserve(m_cacheSize + 3);
+
+	auto cursor = 0u;
+	for (auto n = 0u; n < numTri; ++n)
+	{
+		// Fall back to the next triangle in the input order, when no cached vertex has any
+		// triangles left
+		if (bestTri == UINT32_MAX)
+		{
+			while (isEmitted[cursor]) ++cursor;
+			bestTri = cursor;
+		}
+
+		const auto pTri = &srcIndices[bestTri * 3];
+		memcpy(&pIndices[n * 3], pTri, sizeof(uint32_t) * 3);
+		isEmitted[bestTri] = 1;
+
+		// Remove the triangle from the adjacency of its vertices.
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			const auto v = pTri[i];
+			const auto pBegin = &adjacency[adjOffsets[v]];
+			const auto pEnd = pBegin + numRemaining[v];
+			const auto pTriRef = find(pBegin, pEnd, bestTri);
+			if (pTriRef == pEnd) continue;
+			*pTriRef = pEnd[-1];
+			--numRemaining[v];
+		}
+
+		// Move the triangle vertices to the front of the cache.
+		newCache.clear();
+		for (uint8_t i = 0; i < 3; ++i)
+			if (find(newCache.cbegin(), newCache.cend(), pTri[i]) == newCache.cend())
+				newCache.emplace_back(pTri[i]);
+		for (const auto& v : cache)
+			if (v != pTri[0] && v != pTri[1] && v != pTri[2]) newCache.emplace_back(v);
+		cache.swap(newCache);
+
+		// Update the scores of the cached and the evicted vertices, and of their triangles.
+		for (auto i = 0u; i < static_cast<uint32_t>(cache.size()); ++i)
+		{
+			const auto v = cache[i];
+			cachePos[v] = i < m_cacheSize ? static_cast<int32_t>(i) : -1;
+
+			const auto score = getVertexScore(cachePos[v], numRemaining[v]);
+			const auto delta = score - vertexScores[v];
+			vertexScores[v] = score;
+			for (auto j = 0u; j < numRemaining[v]; ++j) triScores[adjacency[adjOffsets[v] + j]] += delta;
+		}
+		if (cache.size() > m_cacheSize) cache.resize(m_cacheSize);
+
+		// The best candidate is one of the triangles of the cached vertices.
+		bestTri = UINT32_MAX;
+		auto bestScore = -1.0f;
+		for (const auto& v : cache)
+		{
+			for (auto j = 0u; j < numRemaining[v]; ++j)
+			{
+				const auto t = adjacency[adjOffsets[v] + j];
+				if (triScores[t] > bestScore)
+				{
+					bestScore = triScores[t];
+					bestTri = t;
+				}
+			}
+		}
+	}
+}
+
+uint32_t MeshOptimizer::ReorderVertices(vector<uint8_t>& vertices, vector<uint32_t>& indices, uint32_t stride) const
+{
+	const auto numVert = static_cast<uint32_t>(vertices.size() / stride);
+
+	vector<uint32_t> remap(numVert, UINT32_MAX);
+	auto numUsed = 0u;
+	for (auto& index : indices)
+	{
+		if (remap[index] == UINT32_MAX) remap[index] = numUsed++;
+		index = remap[index];
+	}
+
+	vector<uint8_t> reordered(stride * numUsed);
+	for (auto i = 0u; i < numVert; ++i)
+		if (remap[i] != UINT32_MAX) memcpy(&reordered[stride * remap[i]], &vertices[stride * i], stride);
+	vertices.swap(reordered);
+
+	return numUsed;
+}
+
+MeshOptimizer::Stats MeshOptimizer::Analyze(const uint32_t* pIndices, uint32_t numIndices, uint32_t numVertices) const
+{
+	// FIFO cache simulation: a vertex hits when it was transformed within the last
+	// m_cacheSize transforms.
+	vector<uint32_t> timestamps(numVertices, 0);
+	vector<uint8_t> isReferenced(numVertices);
+	auto time = m_cacheSize + 1;
+	auto numTransformed = 0u;
+	auto numReferenced = 0u;
+	for (auto i = 0u; i < numIndices; ++i)
+	{
+		const auto v = pIndices[i];
+		if (time - timestamps[v] > m_cacheSize)
+		{
+			timestamps[v] = time++;
+			++numTransformed;
+		}
+
+		numReferenced += isReferenced[v] ? 0 : 1;
+		isReferenced[v] = 1;
+	}
+
+	Stats stats;
+	stats.NumVertices = numVertices;
+	stats.NumTriangles = numIndices / 3;
+	stats.ACMR = stats.NumTriangles ? static_cast<float>(numTransformed) / stats.NumTriangles : 0.0f;
+	stats.ATVR = numReferenced ? static_cast<float>(numTransformed) / numReferenced : 0.0f;
+
+	return stats;
+}
+
+uint32_t MeshOptimizer::GetCacheSize() const
+{
+	return m_cacheSize;
+}
+
+float MeshOptimizer::getVertexScore(int32_t cachePos, uint32_t numRemaining) const
+{
+	// No triangles left
+	if (numRemaining == 0) return -1.0f;
+
+	auto score = cachePos >= 0 ? m_cacheScores[cachePos] : 0.0f;
+	score += numRemaining < MaxValenceScores ? m_valenceScores[numRemaining] :
+		ValenceBoostScale * powf(static_cast<float>(numRemaining), -ValenceBoostPower);
+
+	return score;
+}
@@ -0,0 +1,53 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace XUSG
+{
+	// Post-import passes over interleaved vertices and triangle-list indices: vertex
+	// welding, post-transform vertex cache ordering (Forsyth), and vertex fetch ordering.
+	class MeshOptimizer
+	{
+	public:
+		struct Stats
+		{
+			uint32_t NumVertices;
+			uint32_t NumTriangles;
+			float ACMR;		// Average cache miss ratio, transformed vertices per triangle
+			float ATVR;		// Average transform to vertex ratio, 1 is optimal
+		};
+
+		// The FIFO size of the simulated post-transform vertex cache
+		MeshOptimizer(uint32_t cacheSize = 32);
+		virtual ~MeshOptimizer();
+
+		// Runs all passes in place, with optional statistics before and after
+		void Optimize(std::vector<uint8_t>& vertices, std::vector<uint32_t>& indices, uint32_t stride,
+			Stats* pBefore = nullptr, Stats* pAfter = nullptr) const;
+
+		// Merges bitwise-identical vertices, returns the new vertex count
+		uint32_t WeldVertices(std::vector<uint8_t>& vertices, std::vector<uint32_t>& indices, uint32_t stride) const;
+		// Reorders triangles for post-transform cache hits, keeping their winding
+		void ReorderTriangles(uint32_t* pIndices, uint32_t numIndices, uint32_t numVertices) const;
+		// Renumbers vertices in the order of first use and drops unreferenced ones,
+		// returns the new vertex count
+		uint32_t ReorderVertices(std::vector<uint8_t>& vertices, std::vector<uint32_t>& indices, uint32_t stride) const;
+
+		Stats Analyze(const uint32_t* pIndices, uint32_t numIndices, uint32_t numVertices) const;
+
+		uint32_t GetCacheSize() const;
+
+	protected:
+		float getVertexScore(int32_t cachePos, uint32_t numRemaining) const;
+
+		std::vector<float> m_cacheScores;
+		std::vector<float> m_valenceScores;
+
+		uint32_t m_cacheSize;
+	};
+}
@@ -0,0 +1,519 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include "XUSGMeshSimplifier.h"
+
+using namespace std;
+using namespace XUSG;
+
+namespace
+{
+	// Border quadrics keep open edges in place relative to the interior planes
+	const float BorderWeight = 10.0f;
+
+	inline uint64_t edgeKey(uint32_t a, uint32_t b)
+	{
+		return (static_cast<uint64_t>(a) << 32) | b;
+	}
+
+	inline void cross(float r[3], const float a[3], const float b[3])
+	{
+		r[0] = a[1] * b[2] - a[2] * b[1];
+		r[1] = a[2] * b[0] - a[0] * b[2];
+		r[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	inline float dot(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	void triangleNormal(float n[3], const float* p0, const float* p1, const float* p2)
+	{
+		const float e1[] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		const float e2[] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		cross(n, e1, e2);
+	}
+
+	template<typename T>
+	void planeQuadric(T& q, const float n[3], float d, float w)
+	{
+		q.A00 = w * n[0] * n[0];
+		q.A11 = w * n[1] * n[1];
+		q.A22 = w * n[2] * n[2];
+		q.A01 = w * n[0] * n[1];
+		q.A02 = w * n[0] * n[2];
+		q.A12 = w * n[1] * n[2];
+		q.B0 = w * n[0] * d;
+		q.B1 = w * n[1] * d;
+		q.B2 = w * n[2] * d;
+		q.C = w * d * d;
+		q.W = w;
+	}
+
+	template<typename T>
+	void addQuadric(T& q, const T& r)
+	{
+		q.A00 += r.A00;
+		q.A11 += r.A11;
+		q.A22 += r.A22;
+		q.A01 += r.A01;
+		q.A02 += r.A02;
+		q.A12 += r.A12;
+		q.B0 += r.B0;
+		q.B1 += r.B1;
+		q.B2 += r.B2;
+		q.C += r.C;
+		q.W += r.W;
+	}
+
+	// Squared distance to the planes, averaged by the weights
+	template<typename T>
+	float evaluateQuadric(const T& q, const float* v)
+	{
+		const auto rx = q.A00 * v[0] + q.A01 * v[1] + q.A02 * v[2] + q.B0 * 2.0f;
+		const auto ry = q.A01 * v[0] + q.A11 * v[1] + q.A12 * v[2] + q.B1 * 2.0f;
+		const auto rz = q.A02 * v[0] + q.A12 * v[1] + q.A22 * v[2] + q.B2 * 2.0f;
+		const auto r = rx * v[0] + ry * v[1] + rz * v[2] + q.C;
+
+		return q.W > 0.0f ? fabs(r) / q.W : 0.0f;
+	}
+}
+
+const uint32_t MeshSimplifier::MaxPasses;
+const uint32_t MeshSimplifier::Version;
+
+MeshSimplifier::MeshSimplifier() :
+	m_scale(1.0f)
+{
+}
+
+MeshSimplifier::~MeshSimplifier()
+{
+}
+
+bool MeshSimplifier::Build(const uint8_t* pVertices, uint32_t stride, uint32_t numVertices,
+	const uint32_t* pIndices, uint32_t numIndices, const float* pRatios, uint32_t numRatios, float maxError)
+{
+	m_lods.clear();
+	m_indices.clear();
+	if (!pVertices || !pIndices || numIndices < 3 || stride < sizeof(float[3])) return false;
+
+	// Normalize the positions to the unit cube for the precision of the quadrics
+	float aabbMin[] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float aabbMax[] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (auto i = 0u; i < numVertices; ++i)
+	{
+		const auto pPos = reinterpret_cast<const float*>(&pVertices[stride * i]);
+		for (uint8_t j = 0; j < 3; ++j)
+		{
+			aabbMin[j] = (min)(aabbMin[j], pPos[j]);
+			aabbMax[j] = (max)(aabbMax[j], pPos[j]);
+		}
+	}
+
+	m_scale = (max)((max)(aabbMax[0] - aabbMin[0], aabbMax[1] - aabbMin[1]), aabbMax[2] - aabbMin[2]);
+	const auto invScale = m_scale > 0.0f ? 1.0f / m_scale : 0.0f;
+	m_positions.resize(3 * numVertices);
+	for (auto i = 0u; i < numVertices; ++i)
+	{
+		const auto pPos = reinterpret_cast<const float*>(&pVertices[stride * i]);
+		for (uint8_t j = 0; j < 3; ++j) m_positions[3 * i + j] = (pPos[j] - aabbMin[j]) * invScale;
+	}
+
+	classifyVertices(pIndices, numIndices, numVertices);
+	computeQuadrics(pIndices, numIndices);
+
+	// LOD 0
+	m_indices.assign(pIndices, pIndices + numIndices);
+	m_lods.push_back({ 0, numIndices, 0.0f });
+
+	vector<uint32_t> indices(pIndices, pIndices + numIndices);
+	auto error = 0.0f;
+	for (auto i = 0u; i < numRatios; ++i)
+	{
+		const auto targetIndices = static_cast<uint32_t>((max)(pRatios[i], 0.0f) * (numIndices / 3)) * 3;
+		const auto numPrevIndices = static_cast<uint32_t>(indices.size());
+		if (targetIndices >= numPrevIndices) continue;
+
+		const auto numLODIndices = simplify(indices.data(), numPrevIndices, targetIndices, maxError * maxError, error);
+		if (numLODIndices >= numPrevIndices) break;
+		indices.resize(numLODIndices);
+
+		m_lods.push_back({ static_cast<uint32_t>(m_indices.size()), numLODIndices, sqrt(error) * m_scale });
+		m_indices.insert(m_indices.end(), indices.cbegin(), indices.cend());
+	}
+
+	return true;
+}
+
+bool MeshSimplifier::Load(const char* fileName, uint64_t sourceKey)
+{
+	m_lods.clear();
+	m_indices.clear();
+
+	ifstream file(fileName, ios::in | ios::binary | ios::ate);
+	if (!file) return false;
+	const auto fileSize = static_cast<uint64_t>(file.tellg());
+	file.seekg(0);
+
+	// Check the sizes against the file before allocating
+	Header header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(Header)) ||
+		memcmp(header.Magic, "XLOD", sizeof(header.Magic)) != 0 || header.Version != Version ||
+		header.SourceKey != sourceKey || header.NumLODs == 0 ||
+		fileSize < sizeof(Header) + sizeof(LOD) * static_cast<uint64_t>(header.NumLODs) +
+		sizeof(uint32_t) * static_cast<uint64_t>(header.NumIndices))
+		return false;
+
+	m_lods.resize(header.NumLODs);
+	m_indices.resize(header.NumIndices);
+	file.read(reinterpret_cast<char*>(m_lods.data()), sizeof(LOD) * header.NumLODs);
+	file.read(reinterpret_cast<char*>(m_indices.data()), sizeof(uint32_t) * header.NumIndices);
+
+	auto valid = file.good();
+	for (const auto& lod : m_lods)
+		valid = valid && lod.IndexOffset <= header.NumIndices && lod.NumIndices <= header.NumIndices - lod.IndexOffset;
+
+	if (!valid)
+	{
+		m_lods.clear();
+		m_indices.clear();
+	}
+
+	return valid;
+}
+
+bool MeshSimplifier::Save(const char* fileName, uint64_t sourceKey) const
+{
+	if (m_lods.empty()) return false;
+
+	Header header = {};
+	memcpy(header.Magic, "XLOD", sizeof(header.Magic));
+	header.Version = Version;
+	header.SourceKey = sourceKey;
+	header.NumLODs = GetNumLODs();
+	header.NumIndices = GetNumIndices();
+
+	ofstream file(fileName, ios::out | ios::binary);
+	if (!file) return false;
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+	file.write(reinterpret_cast<const char*>(m_lods.data()), sizeof(LOD) * header.NumLODs);
+	file.write(reinterpret_cast<const char*>(m_indices.data()), sizeof(uint32_t) * header.NumIndices);
+
+	return file.good();
+}
+
+const MeshSimplifier::LOD* MeshSimplifier::GetLODs() const
+{
+	return m_lods.data();
+}
+
+const uint32_t* MeshSimplifier::GetIndices() const
+{
+	return m_indices.data();
+}
+
+uint32_t MeshSimplifier::GetNumLODs() const
+{
+	return static_cast<uint32_t>(m_lods.size());
+}
+
+uint32_t MeshSimplifier::GetNumIndices() const
+{
+	return static_cast<uint32_t>(m_indices.size());
+}
+
+float MeshSimplifier::GetScreenSpaceError(float error, float distance, float pixelsPerUnit)
+{
+	return distance > 0.0f ? error * pixelsPerUnit / distance : FLT_MAX;
+}
+
+uint64_t MeshSimplifier::GetSourceKey(const uint8_t* pVertices, uint32_t stride, uint32_t numVertices,
+	const uint32_t* pIndices, uint32_t numIndices, const float* pRatios, uint32_t numRatios, float maxError)
+{
+	// FNV-1a over 32-bit words
+	auto key = 14695981039346656037ull;
+	const auto hash = [&key](uint32_t word) { key = (key ^ word) * 1099511628211ull; };
+	const auto hashFloat = [&hash](float value)
+	{
+		uint32_t word;
+		memcpy(&word, &value, sizeof(uint32_t));
+		hash(word);
+	};
+
+	hash(Version);
+	hash(numVertices);
+	hash(numIndices);
+	for (auto i = 0u; i < numVertices; ++i)
+	{
+		const auto pPos = reinterpret_cast<const float*>(&pVertices[stride * i]);
+		for (uint8_t j = 0; j < 3; ++j) hashFloat(pPos[j]);
+	}
+	for (auto i = 0u; i < numIndices; ++i) hash(pIndices[i]);
+	hash(numRatios);
+	for (auto i = 0u; i < numRatios; ++i) hashFloat(pRatios[i]);
+	hashFloat(maxError);
+
+	return key;
+}
+
+void MeshSimplifier::classifyVertices(const uint32_t* pIndices, uint32_t numIndices, uint32_t numVertices)
+{
+	// Remap the vertices to the first vertex of the same position
+	vector<uint32_t> order(numVertices);
+	for (auto i = 0u; i < numVertices; ++i) order[i] = i;
+	const auto pPositions = m_positions.data();
+	const auto less = [pPositions](uint32_t a, uint32_t b)
+	{
+		const auto c = memcmp(&pPositions[3 * a], &pPositions[3 * b], sizeof(float[3]));
+
+		return c < 0 || (c == 0 && a < b);
+	};
+	sort(order.begin(), order.end(), less);
+
+	m_posRemap.resize(numVertices);
+	for (auto i = 0u; i < numVertices; ++i)
+	{
+		const auto prev = i > 0 ? order[i - 1] : UINT32_MAX;
+		const auto isSame = i > 0 && !memcmp(&pPositions[3 * order[i]], &pPositions[3 * prev], sizeof(float[3]));
+		m_posRemap[order[i]] = isSame ? m_posRemap[prev] : order[i];
+	}
+
+	// Positions referenced through more than one vertex are seams
+	vector<uint32_t> wedges(numVertices, UINT32_MAX);
+	m_kinds.assign(numVertices, MANIFOLD);
+	for (auto i = 0u; i < numIndices; ++i)
+	{
+		const auto v = pIndices[i];
+		auto& wedge = wedges[m_posRemap[v]];
+		if (wedge == UINT32_MAX) wedge = v;
+		else if (wedge != v) m_kinds[m_posRemap[v]] = LOCKED;
+	}
+
+	// Count the open edges of each position
+	collectEdges(pIndices, numIndices);
+	vector<uint8_t> numOpenEdges(numVertices);
+	for (auto i = 0u; i < numIndices; i += 3)
+	{
+		for (uint8_t j = 0; j < 3; ++j)
+		{
+			const auto a = m_posRemap[pIndices[i + j]];
+			const auto b = m_posRemap[pIndices[i + (j + 1) % 3]];
+			if (!binary_search(m_edges.cbegin(), m_edges.cend(), edgeKey(b, a)))
+			{
+				numOpenEdges[a] = static_cast<uint8_t>((min)(numOpenEdges[a] + 1, 0xff));
+				numOpenEdges[b] = static_cast<uint8_t>((min)(numOpenEdges[b] + 1, 0xff));
+			}
+		}
+	}
+
+	for (auto i = 0u; i < numVertices; ++i)
+	{
+		const auto p = m_posRemap[i];
+		if (m_kinds[p] == LOCKED || numOpenEdges[p] == 0) continue;
+		m_kinds[p] = numOpenEdges[p] == 2 ? BORDER : LOCKED;
+	}
+
+	// Propagate the kinds to all the vertices of each position
+	for (auto i = 0u; i < numVertices; ++i) m_kinds[i] = m_kinds[m_posRemap[i]];
+}
+
+void MeshSimplifier::computeQuadrics(const uint32_t* pIndices, uint32_t numIndices)
+{
+	m_quadrics.assign(m_posRemap.size(), Quadric());
+
+	for (auto i = 0u; i < numIndices; i += 3)
+	{
+		const float* p[3];
+		uint32_t v[3];
+		for (uint8_t j = 0; j < 3; ++j)
+		{
+			v[j] = m_posRemap[pIndices[i + j]];
+			p[j] = &m_positions[3 * v[j]];
+		}
+
+		float n[3];
+		triangleNormal(n, p[0], p[1], p[2]);
+		const auto l = sqrt(dot(n, n));
+		if (l <= 0.0f) continue;
+		for (auto& c : n) c /= l;
+
+		Quadric q;
+		planeQuadric(q, n, -dot(n, p[0]), 1.0f);
+		for (uint8_t j = 0; j < 3; ++j) addQuadric(m_quadrics[v[j]], q);
+
+		// Planes through the open edges, perpendicular to the triangle
+		for (uint8_t j = 0; j < 3; ++j)
+		{
+			const auto k = (j + 1) % 3;
+			if (binary_search(m_edges.cbegin(), m_edges.cend(), edgeKey(v[k], v[j]))) continue;
+
+			const float e[] = { p[k][0] - p[j][0], p[k][1] - p[j][1], p[k][2] - p[j][2] };
+			float en[3];
+			cross(en, e, n);
+			const auto el = sqrt(dot(en, en));
+			if (el <= 0.0f) continue;
+			for (auto& c : en) c /= el;
+
+			planeQuadric(q, en, -dot(en, p[j]), BorderWeight);
+			addQuadric(m_quadrics[v[j]], q);
+			addQuadric(m_quadrics[v[k]], q);
+		}
+	}
+}
+
+uint32_t MeshSimplifier::simplify(uint32_t* pIndices, uint32_t numIndices, uint32_t targetIndices,
+	float maxCost, float& error)
+{
+	const auto numVertices = static_cast<uint32_t>(m_posRemap.size());
+	vector<Collapse> collapses;
+	vector<uint32_t> collapseRemap(numVertices);
+	vector<uint8_t> isPassLocked(numVertices);
+
+	for (auto pass = 0u; pass < MaxPasses && numIndices > targetIndices; ++pass)
+	{
+		// Vertex-to-triangle adjacency in CSR
+		m_triOffsets.assign(numVertices + 1, 0);
+		for (auto i = 0u; i < numIndices; ++i) ++m_triOffsets[pIndices[i] + 1];
+		for (auto i = 0u; i < numVertices; ++i) m_triOffsets[i + 1] += m_triOffsets[i];
+		m_triangles.resize(numIndices);
+		{
+			vector<uint32_t> offsets(m_triOffsets.cbegin(), m_triOffsets.cend() - 1);
+			for (auto i = 0u; i < numIndices; ++i) m_triangles[offsets[pIndices[i]]++] = i / 3;
+		}
+		collectEdges(pIndices, numIndices);
+
+		// Collect the allowed collapses of the triangle edges
+		collapses.clear();
+		for (auto i = 0u; i < numIndices; i += 3)
+		{
+			for (uint8_t j = 0; j < 3; ++j)
+			{
+				const auto v0 = pIndices[i + j];
+				const auto v1 = pIndices[i + (j + 1) % 3];
+				const auto p0 = m_posRemap[v0];
+				const auto p1 = m_posRemap[v1];
+				if (p0 == p1) continue;
+
+				const auto isBorderEdge = isOpenEdge(p0, p1);
+				for (uint8_t k = 0; k < 2; ++k)
+				{
+					const auto from = k ? v1 : v0;
+					const auto to = k ? v0 : v1;
+					const auto kind = m_kinds[from];
+					if (kind == LOCKED) continue;
+					if (kind == BORDER && (!isBorderEdge || m_kinds[to] == MANIFOLD)) continue;
+
+					auto q = m_quadrics[m_posRemap[from]];
+					addQuadric(q, m_quadrics[m_posRemap[to]]);
+					collapses.push_back({ from, to, evaluateQuadric(q, &m_positions[3 * m_posRemap[to]]) });
+				}
+			}
+		}
+
+		sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.Cost < b.Cost; });
+
+		// Pick the cheapest independent collapses: each removes about 2 triangles, and locks
+		// the one-ring of its source, so that the flip tests stay valid within the pass.
+		const auto maxCollapses = (max)((numIndices - targetIndices) / 6, 1u);
+		auto numCollapses = 0u;
+		for (auto i = 0u; i < numVertices; ++i) collapseRemap[i] = i;
+		fill(isPassLocked.begin(), isPassLocked.end(), 0);
+		for (const auto& collapse : collapses)
+		{
+			if (numCollapses >= maxCollapses || collapse.Cost > maxCost) break;
+			const auto from = collapse.From;
+			const auto to = collapse.To;
+			if (isPassLocked[m_posRemap[from]] || isPassLocked[m_posRemap[to]]) continue;
+			if (hasFlip(from, to, pIndices)) continue;
+
+			collapseRemap[from] = to;
+			addQuadric(m_quadrics[m_posRemap[to]], m_quadrics[m_posRemap[from]]);
+			error = (max)(error, collapse.Cost);
+
+			for (auto j = m_triOffsets[from]; j < m_triOffsets[from + 1]; ++j)
+			{
+				const auto t = m_triangles[j];
+				for (uint8_t k = 0; k < 3; ++k) isPassLocked[m_posRemap[pIndices[3 * t + k]]] = 1;
+			}
+			isPassLocked[m_posRemap[to]] = 1;
+			++numCollapses;
+		}
+
+		if (numCollapses == 0) break;
+
+		// Remap the indices, and drop the degenerate triangles
+		auto numRemaining = 0u;
+		for (auto i = 0u; i < numIndices; i += 3)
+		{
+			const auto v0 = collapseRemap[pIndices[i]];
+			const auto v1 = collapseRemap[pIndices[i + 1]];
+			const auto v2 = collapseRemap[pIndices[i + 2]];
+			const auto p0 = m_posRemap[v0];
+			const auto p1 = m_posRemap[v1];
+			const auto p2 = m_posRemap[v2];
+			if (p0 == p1 || p1 == p2 || p2 == p0) continue;
+
+			pIndices[numRemaining++] = v0;
+			pIndices[numRemaining++] = v1;
+			pIndices[numRemaining++] = v2;
+		}
+		numIndices = numRemaining;
+	}
+
+	return numIndices;
+}
+
+void MeshSimplifier::collectEdges(const uint32_t* pIndices, uint32_t numIndices)
+{
+	// All the directed edges are kept sorted; an edge is open without its reverse
+	m_edges.resize(numIndices);
+	for (auto i = 0u; i < numIndices; i += 3)
+		for (uint8_t j = 0; j < 3; ++j)
+			m_edges[i + j] = edgeKey(m_posRemap[pIndices[i + j]], m_posRemap[pIndices[i + (j + 1) % 3]]);
+	sort(m_edges.begin(), m_edges.end());
+}
+
+bool MeshSimplifier::isOpenEdge(uint32_t a, uint32_t b) const
+{
+	const auto hasAB = binary_search(m_edges.cbegin(), m_edges.cend(), edgeKey(a, b));
+	const auto hasBA = binary_search(m_edges.cbegin(), m_edges.cend(), edgeKey(b, a));
+
+	return hasAB != hasBA;
+}
+
+bool MeshSimplifier::hasFlip(uint32_t from, uint32_t to, const uint32_t* pIndices) const
+{
+	const auto pTo = &m_positions[3 * m_posRemap[to]];
+	for (auto i = m_triOffsets[from]; i < m_triOffsets[from + 1]; ++i)
+	{
+		const auto pTri = &pIndices[3 * m_triangles[i]];
+		if (m_posRemap[pTri[0]] == m_posRemap[to] || m_posRemap[pTri[1]] == m_posRemap[to] ||
+			m_posRemap[pTri[2]] == m_posRemap[to]) continue;
+
+		const float* p[3];
+		const float* q[3];
+		for (uint8_t j = 0; j < 3; ++j)
+		{
+			p[j] = &m_positions[3 * m_posRemap[pTri[j]]];
+			q[j] = pTri[j] == from ? pTo : p[j];
+		}
+
+		float n0[3], n1[3];
+		triangleNormal(n0, p[0], p[1], p[2]);
+		triangleNormal(n1, q[0], q[1], q[2]);
+
+		// Reject flips and near-degenerate slivers
+		if (dot(n0, n1) <= 0.25f * sqrt(dot(n0, n0) * dot(n1, n1))) return true;
+	}
+
+	return false;
+}
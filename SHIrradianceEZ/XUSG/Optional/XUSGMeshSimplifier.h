@@ -0,0 +1,116 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace XUSG
+{
+	// Builds a chain of LODs over a shared vertex buffer by quadric error metric (Garland-
+	// Heckbert) edge collapses onto existing vertices. Vertices sharing a position with
+	// different attributes (seams, e.g. split normals) are kept, and open borders only
+	// collapse along themselves.
+	class MeshSimplifier
+	{
+	public:
+		struct LOD
+		{
+			uint32_t IndexOffset;	// Into GetIndices()
+			uint32_t NumIndices;
+			float Error;			// Object-space deviation from the source, 0 for LOD 0
+		};
+
+		MeshSimplifier();
+		virtual ~MeshSimplifier();
+
+		// LOD 0 is the source, and LOD i + 1 is simplified from LOD i towards pRatios[i] of
+		// the source triangles, so the ratios should be decreasing. A LOD stops short of
+		// its ratio at maxError, relative to the largest extent of the mesh, or when no more
+		// collapses are allowed; the chain ends at the first LOD without reduction.
+		// Positions are the first float3 of each vertex.
+		bool Build(const uint8_t* pVertices, uint32_t stride, uint32_t numVertices,
+			const uint32_t* pIndices, uint32_t numIndices, const float* pRatios, uint32_t numRatios,
+			float maxError = 1.0f);
+		// The LOD chain can be cached across runs; Load() fails unless the file was saved
+		// with the same key, e.g. GetSourceKey() of the inputs of Build()
+		bool Load(const char* fileName, uint64_t sourceKey);
+		bool Save(const char* fileName, uint64_t sourceKey) const;
+
+		const LOD* GetLODs() const;
+		const uint32_t* GetIndices() const;
+		uint32_t GetNumLODs() const;
+		uint32_t GetNumIndices() const;
+
+		// Projected size in pixels of an object-space error at the distance, where
+		// pixelsPerUnit is the projected size of a unit length at distance 1
+		static float GetScreenSpaceError(float error, float distance, float pixelsPerUnit);
+		// Hash of the positions, the indices, and the parameters of Build()
+		static uint64_t GetSourceKey(const uint8_t* pVertices, uint32_t stride, uint32_t numVertices,
+			const uint32_t* pIndices, uint32_t numIndices, const float* pRatios, uint32_t numRatios,
+			float maxError = 1.0f);
+
+	protected:
+		enum VertexKind : uint8_t
+		{
+			MANIFOLD,	// Collapses onto any neighbor
+			BORDER,		// Collapses along its open edges onto a border or locked vertex
+			LOCKED		// Seams and non-manifold vertices
+		};
+
+		// Plane distance quadric: v^T A v + 2 b^T v + c. Planes have unit weights rather than
+		// area weights, so that small features are not averaged out by large triangles.
+		struct Quadric
+		{
+			float A00, A11, A22;
+			float A01, A02, A12;
+			float B0, B1, B2;
+			float C;
+			float W;
+		};
+
+		struct Collapse
+		{
+			uint32_t From;
+			uint32_t To;
+			float Cost;
+		};
+
+		struct Header
+		{
+			char Magic[4];
+			uint32_t Version;
+			uint64_t SourceKey;
+			uint32_t NumLODs;
+			uint32_t NumIndices;
+		};
+
+		static const uint32_t MaxPasses = 256;
+		static const uint32_t Version = 1;
+
+		void classifyVertices(const uint32_t* pIndices, uint32_t numIndices, uint32_t numVertices);
+		void computeQuadrics(const uint32_t* pIndices, uint32_t numIndices);
+		// Simplifies the index list in place, returns the new index count
+		uint32_t simplify(uint32_t* pIndices, uint32_t numIndices, uint32_t targetIndices,
+			float maxCost, float& error);
+		void collectEdges(const uint32_t* pIndices, uint32_t numIndices);
+		bool isOpenEdge(uint32_t a, uint32_t b) const;
+		bool hasFlip(uint32_t from, uint32_t to, const uint32_t* pIndices) const;
+
+		std::vector<float>		m_positions;	// Normalized to the unit cube
+		std::vector<uint32_t>	m_posRemap;		// To the first vertex of the same position
+		std::vector<uint8_t>	m_kinds;
+		std::vector<Quadric>	m_quadrics;		// Per remapped vertex
+
+		std::vector<uint64_t>	m_edges;		// Sorted directed edges of the remapped vertices
+		std::vector<uint32_t>	m_triOffsets;	// Vertex-to-triangle adjacency of the current pass
+		std::vector<uint32_t>	m_triangles;
+
+		std::vector<LOD>		m_lods;
+		std::vector<uint32_t>	m_indices;
+
+		float					m_scale;
+	};
+}
@@ -0,0 +1,363 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include "XUSGMeshletBuilder.h"
+
+using namespace std;
+using namespace XUSG;
+
+namespace
+{
+	// Normal cones wider than this cannot cull reliably
+	const float MinConeDot = 0.1f;
+
+	inline const float* getPosition(const uint8_t* pVertices, uint32_t stride, uint32_t i)
+	{
+		return reinterpret_cast<const float*>(&pVertices[stride * i]);
+	}
+
+	inline float dot(const float* a, const float* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+}
+
+const uint32_t MeshletBuilder::Version;
+const uint32_t MeshletBuilder::MaxLocalIndex;
+
+MeshletBuilder::MeshletBuilder(uint32_t maxVertices, uint32_t maxPrimitives) :
+	m_pMeshlets(nullptr),
+	m_pBounds(nullptr),
+	m_pUniqueVertexIndices(nullptr),
+	m_pPrimitiveIndices(nullptr),
+	m_numMeshlets(0),
+	m_numUniqueVertexIndices(0),
+	m_numPrimitives(0),
+	m_maxVertices((min)((max)(maxVertices, 3u), MaxLocalIndex)),
+	m_maxPrimitives((max)(maxPrimitives, 1u))
+{
+}
+
+MeshletBuilder::~MeshletBuilder()
+{
+}
+
+bool MeshletBuilder::Build(const uint8_t* pVertices, uint32_t stride, uint32_t numVertices,
+	const uint32_t* pIndices, uint32_t numIndices)
+{
+	reset();
+
+	for (auto i = 0u; i < numIndices; ++i) if (pIndices[i] >= numVertices) return false;
+
+	// Greedy clustering in the index order; localIndices maps the vertices of the
+	// current meshlet to their local indices.
+	vector<uint32_t> localIndices(numVertices, UINT32_MAX);
+	Meshlet meshlet = {};
+	const auto flush = [&]()
+	{
+		if (meshlet.PrimitiveCount == 0) return;
+
+		for (auto i = 0u; i < meshlet.VertexCount; ++i)
+			localIndices[m_uniqueVertexIndices[meshlet.VertexOffset + i]] = UINT32_MAX;
+		m_meshlets.emplace_back(meshlet);
+
+		meshlet.VertexCount = 0;
+		meshlet.VertexOffset = static_cast<uint32_t>(m_uniqueVertexIndices.size());
+		meshlet.PrimitiveCount = 0;
+		meshlet.PrimitiveOffset = static_cast<uint32_t>(m_primitiveIndices.size());
+	};
+
+	const auto numTri = numIndices / 3;
+	for (auto i = 0u; i < numTri; ++i)
+	{
+		const auto pTri = &pIndices[i * 3];
+		auto numNewVerts = 0u;
+		for (uint8_t j = 0; j < 3; ++j)
+			numNewVerts += localIndices[pTri[j]] == UINT32_MAX && find(pTri, pTri + j, pTri[j]) == pTri + j ? 1 : 0;
+
+		if (meshlet.VertexCount + numNewVerts > m_maxVertices || meshlet.PrimitiveCount >= m_maxPrimitives) flush();
+
+		uint32_t primitive = 0;
+		for (uint8_t j = 0; j < 3; ++j)
+		{
+			auto& localIndex = localIndices[pTri[j]];
+			if (localIndex == UINT32_MAX)
+			{
+				localIndex = meshlet.VertexCount++;
+				m_uniqueVertexIndices.emplace_back(pTri[j]);
+			}
+			primitive |= localIndex << (10 * j);
+		}
+
+		m_primitiveIndices.emplace_back(primitive);
+		++meshlet.PrimitiveCount;
+	}
+	flush();
+
+	m_bounds.resize(m_meshlets.size());
+	for (size_t i = 0; i < m_meshlets.size(); ++i) computeBounds(m_bounds[i], m_meshlets[i], pVertices, stride);
+
+	m_pMeshlets = m_meshlets.data();
+	m_pBounds = m_bounds.data();
+	m_pUniqueVertexIndices = m_uniqueVertexIndices.data();
+	m_pPrimitiveIndices = m_primitiveIndices.data();
+	m_numMeshlets = static_cast<uint32_t>(m_meshlets.size());
+	m_numUniqueVertexIndices = static_cast<uint32_t>(m_uniqueVertexIndices.size());
+	m_numPrimitives = static_cast<uint32_t>(m_primitiveIndices.size());
+
+	return true;
+}
+
+bool MeshletBuilder::Load(const char* fileName)
+{
+	reset();
+	if (!m_file.Open(fileName)) return false;
+
+	Header header;
+	if (m_file.GetSize() < sizeof(Header))
+	{
+		m_file.Close();
+		return false;
+	}
+	memcpy(&header, m_file.GetData(), sizeof(Header));
+
+	const auto dataSize = (sizeof(Meshlet) + sizeof(Bounds)) * header.NumMeshlets +
+		sizeof(uint32_t) * (static_cast<uint64_t>(header.NumUniqueVertexIndices) + header.NumPrimitives);
+	if (memcmp(header.Magic, "XMLT", sizeof(header.Magic)) != 0 || header.Version != Version ||
+		header.MaxVertices > MaxLocalIndex || m_file.GetSize() < sizeof(Header) + dataSize)
+	{
+		m_file.Close();
+		return false;
+	}
+
+	auto pData = m_file.GetData() + sizeof(Header);
+	const auto pMeshlets = reinterpret_cast<const Meshlet*>(pData);
+	pData += sizeof(Meshlet) * header.NumMeshlets;
+	const auto pBounds = reinterpret_cast<const Bounds*>(pData);
+	pData += sizeof(Bounds) * header.NumMeshlets;
+	const auto pUniqueVertexIndices = reinterpret_cast<const uint32_t*>(pData);
+	pData += sizeof(uint32_t) * header.NumUniqueVertexIndices;
+	const auto pPrimitiveIndices = reinterpret_cast<const uint32_t*>(pData);
+
+	// Validate every meshlet, so that stale or corrupt files cannot index out of range
+	for (auto i = 0u; i < header.NumMeshlets; ++i)
+	{
+		const auto& meshlet = pMeshlets[i];
+		auto valid = meshlet.VertexCount <= header.MaxVertices && meshlet.PrimitiveCount <= header.MaxPrimitives &&
+			meshlet.VertexOffset <= header.NumUniqueVertexIndices &&
+			meshlet.VertexCount <= header.NumUniqueVertexIndices - meshlet.VertexOffset &&
+			meshlet.PrimitiveOffset <= header.NumPrimitives &&
+			meshlet.PrimitiveCount <= header.NumPrimitives - meshlet.PrimitiveOffset;
+
+		for (auto j = 0u; valid && j < meshlet.PrimitiveCount; ++j)
+		{
+			uint32_t i0, i1, i2;
+			UnpackPrimitive(pPrimitiveIndices[meshlet.PrimitiveOffset + j], i0, i1, i2);
+			valid = i0 < meshlet.VertexCount && i1 < meshlet.VertexCount && i2 < meshlet.VertexCount;
+		}
+
+		if (!valid)
+		{
+			m_file.Close();
+			return false;
+		}
+	}
+
+	m_pMeshlets = pMeshlets;
+	m_pBounds = pBounds;
+	m_pUniqueVertexIndices = pUniqueVertexIndices;
+	m_pPrimitiveIndices = pPrimitiveIndices;
+	m_numMeshlets = header.NumMeshlets;
+	m_numUniqueVertexIndices = header.NumUniqueVertexIndices;
+	m_numPrimitives = header.NumPrimitives;
+	m_maxVertices = header.MaxVertices;
+	m_maxPrimitives = header.MaxPrimitives;
+
+	return true;
+}
+
+bool MeshletBuilder::Save(const char* fileName) const
+{
+	if (!m_pMeshlets) return false;
+
+	Header header = {};
+	memcpy(header.Magic, "XMLT", sizeof(header.Magic));
+	header.Version = Version;
+	header.MaxVertices = m_maxVertices;
+	header.MaxPrimitives = m_maxPrimitives;
+	header.NumMeshlets = m_numMeshlets;
+	header.NumUniqueVertexIndices = m_numUniqueVertexIndices;
+	header.NumPrimitives = m_numPrimitives;
+
+	ofstream file(fileName, ios::out | ios::binary);
+	if (!file) return false;
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+	file.write(reinterpret_cast<const char*>(m_pMeshlets), sizeof(Meshlet) * m_numMeshlets);
+	file.write(reinterpret_cast<const char*>(m_pBounds), sizeof(Bounds) * m_numMeshlets);
+	file.write(reinterpret_cast<const char*>(m_pUniqueVertexIndices), sizeof(uint32_t) * m_numUniqueVertexIndices);
+	file.write(reinterpret_cast<const char*>(m_pPrimitiveIndices), sizeof(uint32_t) * m_numPrimitives);
+
+	return file.good();
+}
+
+const MeshletBuilder::Meshlet* MeshletBuilder::GetMeshlets() const
+{
+	return m_pMeshlets;
+}
+
+const MeshletBuilder::Bounds* MeshletBuilder::GetBounds() const
+{
+	return m_pBounds;
+}
+
+const uint32_t* MeshletBuilder::GetUniqueVertexIndices() const
+{
+	return m_pUniqueVertexIndices;
+}
+
+const uint32_t* MeshletBuilder::GetPrimitiveIndices() const
+{
+	return m_pPrimitiveIndices;
+}
+
+uint32_t MeshletBuilder::GetNumMeshlets() const
+{
+	return m_numMeshlets;
+}
+
+uint32_t MeshletBuilder::GetNumUniqueVertexIndices() const
+{
+	return m_numUniqueVertexIndices;
+}
+
+uint32_t MeshletBuilder::GetNumPrimitives() const
+{
+	return m_numPrimitives;
+}
+
+uint32_t MeshletBuilder::GetMaxVertices() const
+{
+	return m_maxVertices;
+}
+
+uint32_t MeshletBuilder::GetMaxPrimitives() const
+{
+	return m_maxPrimitives;
+}
+
+void MeshletBuilder::UnpackPrimitive(uint32_t primitive, uint32_t& i0, uint32_t& i1, uint32_t& i2)
+{
+	i0 = primitive & 0x3ff;
+	i1 = (primitive >> 10) & 0x3ff;
+	i2 = (primitive >> 20) & 0x3ff;
+}
+
+void MeshletBuilder::reset()
+{
+	m_file.Close();
+	m_meshlets.clear();
+	m_bounds.clear();
+	m_uniqueVertexIndices.clear();
+	m_primitiveIndices.clear();
+	m_pMeshlets = nullptr;
+	m_pBounds = nullptr;
+	m_pUniqueVertexIndices = nullptr;
+	m_pPrimitiveIndices = nullptr;
+	m_numMeshlets = m_numUniqueVertexIndices = m_numPrimitives = 0;
+}
+
+void MeshletBuilder::computeBounds(Bounds& bounds, const Meshlet& meshlet, const uint8_t* pVertices, uint32_t stride) const
+{
+	const auto pVertexIndices = &m_uniqueVertexIndices[meshlet.VertexOffset];
+	const auto pPrimitives = &m_primitiveIndices[meshlet.PrimitiveOffset];
+
+	// Bounding sphere around the center of the AABB
+	float minPos[3], maxPos[3];
+	memcpy(minPos, getPosition(pVertices, stride, pVertexIndices[0]), sizeof(minPos));
+	memcpy(maxPos, minPos, sizeof(maxPos));
+	for (auto i = 1u; i < meshlet.VertexCount; ++i)
+	{
+		const auto p = getPosition(pVertices, stride, pVertexIndices[i]);
+		for (uint8_t j = 0; j < 3; ++j)
+		{
+			minPos[j] = (min)(minPos[j], p[j]);
+			maxPos[j] = (max)(maxPos[j], p[j]);
+		}
+	}
+
+	auto radiusSq = 0.0f;
+	for (uint8_t j = 0; j < 3; ++j) bounds.Center[j] = (minPos[j] + maxPos[j]) * 0.5f;
+	for (auto i = 0u; i < meshlet.VertexCount; ++i)
+	{
+		const auto p = getPosition(pVertices, stride, pVertexIndices[i]);
+		const float d[] = { p[0] - bounds.Center[0], p[1] - bounds.Center[1], p[2] - bounds.Center[2] };
+		radiusSq = (max)(radiusSq, dot(d, d));
+	}
+	bounds.Radius = sqrt(radiusSq);
+
+	// Face normals, with the same winding as ObjLoader::recomputeNormals()
+	vector<float> normals(meshlet.PrimitiveCount * 3);
+	float axis[3] = {};
+	for (auto i = 0u; i < meshlet.PrimitiveCount; ++i)
+	{
+		uint32_t i0, i1, i2;
+		UnpackPrimitive(pPrimitives[i], i0, i1, i2);
+		const auto p0 = getPosition(pVertices, stride, pVertexIndices[i0]);
+		const auto p1 = getPosition(pVertices, stride, pVertexIndices[i1]);
+		const auto p2 = getPosition(pVertices, stride, pVertexIndices[i2]);
+		const float e1[] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		const float e2[] = { p2[0] - p1[0], p2[1] - p1[1], p2[2] - p1[2] };
+
+		auto n = &normals[i * 3];
+		n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+		const auto l = sqrt(dot(n, n));
+		for (uint8_t j = 0; j < 3; ++j)
+		{
+			n[j] = l > 0.0f ? n[j] / l : 0.0f;
+			axis[j] += n[j];
+		}
+	}
+
+	// Normal cone; degenerate triangles do not constrain it.
+	const auto axisLen = sqrt(dot(axis, axis));
+	auto minDot = axisLen > 0.0f ? 1.0f : -1.0f;
+	for (uint8_t j = 0; j < 3; ++j) axis[j] = axisLen > 0.0f ? axis[j] / axisLen : 0.0f;
+	for (auto i = 0u; i < meshlet.PrimitiveCount; ++i)
+	{
+		const auto n = &normals[i * 3];
+		if (dot(n, n) > 0.0f) minDot = (min)(minDot, dot(n, axis));
+	}
+
+	memcpy(bounds.ConeAxis, axis, sizeof(axis));
+	memcpy(bounds.ConeApex, bounds.Center, sizeof(bounds.ConeApex));
+	bounds.Reserved = 0.0f;
+	if (minDot < MinConeDot)
+	{
+		bounds.ConeCutoff = 1.0f;
+		return;
+	}
+	bounds.ConeCutoff = sqrt(1.0f - minDot * minDot);
+
+	// Move the apex back along the axis, until it is behind all the triangle planes.
+	auto maxT = 0.0f;
+	for (auto i = 0u; i < meshlet.PrimitiveCount; ++i)
+	{
+		const auto n = &normals[i * 3];
+		if (dot(n, n) <= 0.0f) continue;
+
+		uint32_t i0, i1, i2;
+		UnpackPrimitive(pPrimitives[i], i0, i1, i2);
+		const auto p0 = getPosition(pVertices, stride, pVertexIndices[i0]);
+		const float d[] = { bounds.Center[0] - p0[0], bounds.Center[1] - p0[1], bounds.Center[2] - p0[2] };
+		maxT = (max)(maxT, dot(d, n) / dot(axis, n));
+	}
+	for (uint8_t j = 0; j < 3; ++j) bounds.ConeApex[j] = bounds.Center[j] - axis[j] * maxT;
+}
@@ -0,0 +1,99 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "XUSGMappedFile.h"
+
+namespace XUSG
+{
+	// Splits triangle lists into clusters (meshlets) of bounded vertex and triangle counts,
+	// with bounding spheres and normal cones for cluster culling. The layout matches the
+	// D3D12 mesh shader samples: per-meshlet ranges into a unique vertex index array and
+	// a primitive array of 10:10:10 packed local triangles.
+	class MeshletBuilder
+	{
+	public:
+		struct Meshlet
+		{
+			uint32_t VertexCount;
+			uint32_t VertexOffset;
+			uint32_t PrimitiveCount;
+			uint32_t PrimitiveOffset;
+		};
+
+		// A cluster is entirely back-facing from the eye point, if
+		// dot(Center - eye, ConeAxis) >= ConeCutoff * length(Center - eye) + Radius,
+		// or equivalently dot(normalize(ConeApex - eye), ConeAxis) >= ConeCutoff.
+		struct Bounds
+		{
+			float Center[3];
+			float Radius;
+			float ConeApex[3];
+			float ConeCutoff;	// Sine of the normal cone half-angle, 1 if the cone is too wide to cull
+			float ConeAxis[3];
+			float Reserved;
+		};
+
+		MeshletBuilder(uint32_t maxVertices = 64, uint32_t maxPrimitives = 124);
+		virtual ~MeshletBuilder();
+
+		// Clusters the triangles greedily in the index order, which should have vertex
+		// locality, e.g. after MeshOptimizer. Positions are the first float3 of each vertex.
+		bool Build(const uint8_t* pVertices, uint32_t stride, uint32_t numVertices,
+			const uint32_t* pIndices, uint32_t numIndices);
+		bool Load(const char* fileName);
+		bool Save(const char* fileName) const;
+
+		const Meshlet* GetMeshlets() const;
+		const Bounds* GetBounds() const;
+		const uint32_t* GetUniqueVertexIndices() const;
+		const uint32_t* GetPrimitiveIndices() const;
+		uint32_t GetNumMeshlets() const;
+		uint32_t GetNumUniqueVertexIndices() const;
+		uint32_t GetNumPrimitives() const;
+		uint32_t GetMaxVertices() const;
+		uint32_t GetMaxPrimitives() const;
+
+		static void UnpackPrimitive(uint32_t primitive, uint32_t& i0, uint32_t& i1, uint32_t& i2);
+
+	protected:
+		struct Header
+		{
+			char Magic[4];
+			uint32_t Version;
+			uint32_t MaxVertices;
+			uint32_t MaxPrimitives;
+			uint32_t NumMeshlets;
+			uint32_t NumUniqueVertexIndices;
+			uint32_t NumPrimitives;
+			uint32_t Reserved;
+		};
+
+		static const uint32_t Version = 1;
+		static const uint32_t MaxLocalIndex = 1 << 10;
+
+		void reset();
+		void computeBounds(Bounds& bounds, const Meshlet& meshlet, const uint8_t* pVertices, uint32_t stride) const;
+
+		std::vector<Meshlet>	m_meshlets;
+		std::vector<Bounds>		m_bounds;
+		std::vector<uint32_t>	m_uniqueVertexIndices;
+		std::vector<uint32_t>	m_primitiveIndices;
+		MappedFile				m_file;
+
+		const Meshlet*			m_pMeshlets;
+		const Bounds*			m_pBounds;
+		const uint32_t*			m_pUniqueVertexIndices;
+		const uint32_t*			m_pPrimitiveIndices;
+		uint32_t				m_numMeshlets;
+		uint32_t				m_numUniqueVertexIndices;
+		uint32_t				m_numPrimitives;
+
+		uint32_t				m_maxVertices;
+		uint32_t				m_maxPrimitives;
+	};
+}
@@ -2,12 +2,155 @@
 // Copyright (c) XU, Tianchen. All rights reserved.
 //--------------------------------------------------------------------------------------
 
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <string>
+#if defined(_M_X64) || defined(__x86_64__)
+#include <xmmintrin.h>
+#endif
 #include "XUSGObjLoader.h"
 
 using namespace std;
 using namespace XUSG;
 
-ObjLoader::ObjLoader()
+namespace
+{
+	const double Pow10[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	inline bool isBlank(char c)
+	{
+		return c == ' ' || c == '\t';
+	}
+
+	inline bool isDigit(char c)
+	{
+		return static_cast<uint8_t>(c - '0') < 10;
+	}
+
+	inline bool isSpace(char c)
+	{
+		return isBlank(c) || c == '\r' || c == '\n';
+	}
+
+	inline const char* skipBlanks(const char* p, const char* pEnd)
+	{
+		while (p < pEnd && isBlank(*p)) ++p;
+
+		return p;
+	}
+
+	inline const char* skipLine(const char* p, const char* pEnd)
+	{
+		p = static_cast<const char*>(memchr(p, '\n', pEnd - p));
+
+		return p ? p + 1 : pEnd;
+	}
+
+	bool parseInt(const char*& p, const char* pEnd, int64_t& value)
+	{
+		p = skipBlanks(p, pEnd);
+
+		auto pCur = p;
+		const auto isNegative = pCur < pEnd && *pCur == '-';
+		if (pCur < pEnd && (*pCur == '-' || *pCur == '+')) ++pCur;
+		if (pCur >= pEnd || !isDigit(*pCur)) return false;
+
+		value = 0;
+		for (; pCur < pEnd && isDigit(*pCur); ++pCur) value = value * 10 + (*pCur - '0');
+		value = isNegative ? -value : value;
+		p = pCur;
+
+		return true;
+	}
+
+	// Decimal values with up to 19 significant digits and |exponent| <= 22 are converted
+	// exactly in double precision; anything else falls back to strtod().
+	bool parseFloat(const char*& p, const char* pEnd, float& value)
+	{
+		p = skipBlanks(p, pEnd);
+
+		auto pCur = p;
+		const auto isNegative = pCur < pEnd && *pCur == '-';
+		if (pCur < pEnd && (*pCur == '-' || *pCur == '+')) ++pCur;
+
+		uint64_t mantissa = 0;
+		auto exponent = 0;
+		auto numDigits = 0;
+		auto hasDigits = false;
+		for (; pCur < pEnd && isDigit(*pCur); ++pCur, hasDigits = true)
+		{
+			if (numDigits < 19)
+			{
+				mantissa = mantissa * 10 + (*pCur - '0');
+				numDigits += mantissa ? 1 : 0;
+			}
+			else ++exponent;
+		}
+
+		if (pCur < pEnd && *pCur == '.')
+		{
+			for (++pCur; pCur < pEnd && isDigit(*pCur); ++pCur, hasDigits = true)
+			{
+				if (numDigits < 19)
+				{
+					mantissa = mantissa * 10 + (*pCur - '0');
+					numDigits += mantissa ? 1 : 0;
+					--exponent;
+				}
+			}
+		}
+
+		if (hasDigits && pCur < pEnd && (*pCur == 'e' || *pCur == 'E'))
+		{
+			auto pExp = pCur + 1;
+			int64_t e;
+			if (pExp < pEnd && !isBlank(*pExp) && parseInt(pExp, pEnd, e))
+			{
+				exponent += static_cast<int>((max)((min)(e, int64_t(1000)), int64_t(-1000)));
+				pCur = pExp;
+			}
+		}
+
+		if (hasDigits && (pCur >= pEnd || isSpace(*pCur)) && mantissa < (1ull << 53) && exponent >= -22 && exponent <= 22)
+		{
+			auto d = static_cast<double>(mantissa);
+			d = exponent < 0 ? d / Pow10[-exponent] : d * Pow10[exponent];
+			value = static_cast<float>(isNegative ? -d : d);
+			p = pCur;
+
+			return true;
+		}
+
+		// Slow path, e.g. for inf, nan, or long mantissas
+		char buffer[64];
+		auto n = 0u;
+		for (pCur = p; pCur < pEnd && !isSpace(*pCur) && n + 1 < sizeof(buffer); ++pCur) buffer[n++] = *pCur;
+		buffer[n] = '\0';
+
+		char* pStop;
+		value = strtof(buffer, &pStop);
+		if (pStop == buffer) return false;
+		p += pStop - buffer;
+
+		return true;
+	}
+}
+
+const uint32_t ObjLoader::MinChunkSize;
+const uint32_t ObjLoader::ElementsPerTask;
+const uint32_t ObjLoader::CacheVersion;
+
+ObjLoader::ObjLoader(uint32_t numThreads, bool useCache) :
+	m_threadPool(new ThreadPool(numThreads)),
+	m_pCache(nullptr),
+	m_useCache(useCache),
+	m_optimizationStats(),
+	m_isOptimized(false)
 {
 }
 
@@ -15,38 +158,139 @@ ObjLoader::~ObjLoader()
 {
 }
 
-bool ObjLoader::Import(const char* pszFilename, bool needNorm, bool needAABB, bool forDX, bool swapYZ)
+bool ObjLoader::Import(const char* pszFilename, bool needNorm, bool needAABB, bool forDX, bool swapYZ, bool optimize)
 {
-	FILE* pFile;
-	fopen_s(&pFile, pszFilename, "r");
+	m_isOptimized = false;
+	m_pCache = nullptr;
+	m_cacheFile.Close();
+
+	MappedFile file;
+	if (!file.Open(pszFilename))
+	{
+		// Empty files cannot be mapped, but import as empty meshes.
+		ifstream fileStream(pszFilename, ios::in | ios::binary | ios::ate);
+		if (!fileStream || fileStream.tellg() != 0) return false;
+	}
+
+	// Try the binary sidecar of the same source file and flags.
+	CacheHeader cacheHeader = {};
+	memcpy(cacheHeader.Magic, "XOBJ", sizeof(cacheHeader.Magic));
+	cacheHeader.Version = CacheVersion;
+	cacheHeader.Flags = (needNorm ? 1 : 0) | (needAABB ? 2 : 0) | (forDX ? 4 : 0) | (swapYZ ? 8 : 0) | (optimize ? 16 : 0);
+	cacheHeader.SourceSize = file.GetSize();
+	cacheHeader.SourceTime = file.GetModifiedTime();
+
+	const auto cacheFileName = string(pszFilename) + "." + to_string(cacheHeader.Flags) + ".xmesh";
+	if (m_useCache && loadCache(cacheFileName.c_str(), cacheHeader)) return true;
+
+	// Split the file at line boundaries.
+	const auto pData = reinterpret_cast<const char*>(file.GetData());
+	const auto size = file.GetSize();
+	const auto numChunks = static_cast<uint32_t>((max<size_t>)((min<size_t>)(size / MinChunkSize, m_threadPool->GetNumThreads() * 4), 1));
+	vector<const char*> chunkBegins(numChunks + 1);
+	chunkBegins[0] = pData;
+	chunkBegins[numChunks] = pData + size;
+	for (auto i = 1u; i < numChunks; ++i)
+	{
+		const auto p = pData + size * i / numChunks;
+		chunkBegins[i] = (max)(p > pData && p[-1] == '\n' ? p : skipLine(p, pData + size), chunkBegins[i - 1]);
+	}
+
+	// Parse the chunks concurrently.
+	vector<Geometry> geometries(numChunks);
+	m_threadPool->ParallelFor(numChunks, [&](uint32_t i)
+	{
+		parseGeometry(chunkBegins[i], chunkBegins[i + 1], geometries[i], forDX, swapYZ);
+	});
+
+	// Prefix-sum the chunk-local counts.
+	struct Bases
+	{
+		uint32_t Vertex;
+		uint32_t Normal;
+		uint32_t Index;
+	};
+
+	vector<Bases> bases(numChunks + 1);
+	bases[0] = {};
+	auto numTexc = 0u;
+	for (auto i = 0u; i < numChunks; ++i)
+	{
+		const auto& geometry = geometries[i];
+		bases[i + 1].Vertex = bases[i].Vertex + static_cast<uint32_t>(geometry.Positions.size());
+		bases[i + 1].Normal = bases[i].Normal + static_cast<uint32_t>(geometry.Normals.size());
+		bases[i + 1].Index = bases[i].Index + static_cast<uint32_t>(geometry.Indices.size());
+		numTexc += geometry.NumTexcoords;
+	}
 
-	if (!pFile) return false;
+	const auto numVert = bases[numChunks].Vertex;
+	const auto numNorm = bases[numChunks].Normal;
 
+	// Stitch the chunks, and interleave the vertices.
 	m_stride = sizeof(float3);
-	m_stride += needNorm ? sizeof(float3) : 0;
+	m_stride += needNorm || numNorm ? sizeof(float3) : 0;
+	m_stride += numTexc ? sizeof(float[2]) : 0;
+	m_vertices.clear();
+	m_vertices.reserve(m_stride * (max)((max)(numVert, numTexc), numNorm));
+	m_vertices.resize(m_stride * numVert);
+	m_indices.resize(bases[numChunks].Index);
+
+	vector<float3> normals(numNorm);
+	vector<uint32_t> nIndices(bases[numChunks].Index);
+	vector<uint8_t> isValid(numChunks);
+	m_threadPool->ParallelFor(numChunks, [&](uint32_t i)
+	{
+		auto& geometry = geometries[i];
+		const auto& base = bases[i];
+
+		for (const auto& j : geometry.RelIndices) geometry.Indices[j] += base.Vertex;
+		for (const auto& j : geometry.RelNIndices) geometry.NIndices[j] += base.Normal;
+
+		auto valid = true;
+		for (const auto& j : geometry.Indices) valid = valid && j < numVert;
+		isValid[i] = valid;
 
-	// Import the OBJ file.
-	uint32_t numTexc, numNorm;
-	importGeometryFirstPass(pFile, numTexc, numNorm);
-	rewind(pFile);
-	importGeometrySecondPass(pFile, numTexc, numNorm, forDX, swapYZ);
-	fclose(pFile);
+		const auto numChunkVert = static_cast<uint32_t>(geometry.Positions.size());
+		for (auto j = 0u; j < numChunkVert; ++j) getPosition(base.Vertex + j) = geometry.Positions[j];
+		copy(geometry.Normals.cbegin(), geometry.Normals.cend(), normals.begin() + base.Normal);
+		copy(geometry.Indices.cbegin(), geometry.Indices.cend(), m_indices.begin() + base.Index);
+		copy(geometry.NIndices.cbegin(), geometry.NIndices.cend(), nIndices.begin() + base.Index);
+		geometry = Geometry();
+	});
+
+	file.Close();
+	for (const auto& valid : isValid) if (!valid) return false;
+
+	computePerVertexNormals(normals, nIndices);
+
+	if ((forDX && !swapYZ) || (!forDX && swapYZ)) reverse(m_indices.begin(), m_indices.end());
 
 	// Perform post import tasks.
 	if (needNorm && !numNorm) recomputeNormals();
-	if (needAABB) computeAABB();
+	if (needAABB && numVert > 0) computeAABB();
+	if (optimize)
+	{
+		MeshOptimizer().Optimize(m_vertices, m_indices, m_stride, &m_optimizationStats[0], &m_optimizationStats[1]);
+		m_isOptimized = true;
+	}
+
+	if (m_useCache)
+	{
+		cacheHeader.BoundingBox = needAABB && numVert > 0 ? m_aabb : AABB();
+		saveCache(cacheFileName.c_str(), cacheHeader);
+	}
 
 	return true;
 }
 
 const uint32_t ObjLoader::GetNumVertices() const
 {
-	return static_cast<uint32_t>(m_vertices.size() / GetVertexStride());
+	return m_pCache ? m_pCache->NumVertices : static_cast<uint32_t>(m_vertices.size() / GetVertexStride());
 }
 
 const uint32_t ObjLoader::GetNumIndices() const
 {
-	return static_cast<uint32_t>(m_indices.size());
+	return m_pCache ? m_pCache->NumIndices : static_cast<uint32_t>(m_indices.size());
 }
 
 const uint32_t ObjLoader::GetVertexStride() const
@@ -56,12 +300,12 @@ const uint32_t ObjLoader::GetVertexStride() const
 
 const uint8_t* ObjLoader::GetVertices() const
 {
-	return m_vertices.data();
+	return m_pCache ? reinterpret_cast<const uint8_t*>(&m_pCache[1]) : m_vertices.data();
 }
 
 const uint32_t* ObjLoader::GetIndices() const
 {
-	return m_indices.data();
+	return m_pCache ? reinterpret_cast<const uint32_t*>(GetVertices() + m_pCache->Stride * m_pCache->NumVertices) : m_indices.data();
 }
 
 const ObjLoader::AABB& ObjLoader::GetAABB() const
@@ -69,231 +313,110 @@ const ObjLoader::AABB& ObjLoader::GetAABB() const
 	return m_aabb;
 }
 
-void ObjLoader::importGeometryFirstPass(FILE* pFile, uint32_t& numTexc, uint32_t& numNorm)
+bool ObjLoader::GetOptimizationStats(MeshOptimizer::Stats& before, MeshOptimizer::Stats& after) const
 {
-	auto v = 0u;
-	auto vt = 0u;
-	auto vn = 0u;
-	char buffer[256] = { 0 };
-
-	auto numVert = 0u;
-	auto numTri = 0u;
-	numTexc = 0;
-	numNorm = 0;
-
-	while (fscanf_s(pFile, "%s", buffer, static_cast<uint32_t>(sizeof(buffer))) != EOF)
-	{
-		switch (buffer[0])
-		{
-		case 'f':   // v, v//vn, v/vt, v/vt/vn.
-			fscanf_s(pFile, "%s", buffer, static_cast<uint32_t>(sizeof(buffer)));
-
-			if (strstr(buffer, "//")) // v//vn
-			{
-				sscanf_s(buffer, "%u//%u", &v, &vn);
-				fscanf_s(pFile, "%u//%u", &v, &vn);
-				fscanf_s(pFile, "%u//%u", &v, &vn);
-				++numTri;
-
-				while (fscanf_s(pFile, "%u//%u", &v, &vn) > 0) ++numTri;
-			}
-			else if (sscanf_s(buffer, "%u/%u/%u", &v, &vt, &vn) == 3) // v/vt/vn
-			{
-				fscanf_s(pFile, "%u/%u/%u", &v, &vt, &vn);
-				fscanf_s(pFile, "%u/%u/%u", &v, &vt, &vn);
-				++numTri;
-
-				while (fscanf_s(pFile, "%u/%u/%u", &v, &vt, &vn) > 0) ++numTri;
-
-				//m_hasTexcoord = true;
-			}
-			else if (sscanf_s(buffer, "%u/%u", &v, &vt) == 2) // v/vt
-			{
-				fscanf_s(pFile, "%u/%u", &v, &vt);
-				fscanf_s(pFile, "%u/%u", &v, &vt);
-				++numTri;
-
-				while (fscanf_s(pFile, "%u/%u", &v, &vt) > 0) ++numTri;
-
-				//m_hasTexcoord = true;
-			}
-			else // v
-			{
-				fscanf_s(pFile, "%u", &v);
-				fscanf_s(pFile, "%u", &v);
-				++numTri;
-
-				while (fscanf_s(pFile, "%u", &v) > 0)
-					++numTri;
-			}
-			break;
-
-		case 'v':   // v, vt, or vn
-			switch (buffer[1])
-			{
-			case '\0':
-				fgets(buffer, sizeof(buffer), pFile);
-				++numVert;
-				break;
-			case 't':
-				fgets(buffer, sizeof(buffer), pFile);
-				++numTexc;
-				break;
-			case 'n':
-				fgets(buffer, sizeof(buffer), pFile);
-				++numNorm;
-				break;
-			default:
-				break;
-			}
-			break;
+	if (!m_isOptimized) return false;
 
-		default:
-			fgets(buffer, sizeof(buffer), pFile);
-			break;
-		}
-	}
+	before = m_optimizationStats[0];
+	after = m_optimizationStats[1];
 
-	// Allocate memory for the OBJ model data.
-	const auto numIdx = numTri * 3;
-	m_stride += m_stride <= sizeof(float3) && numNorm ? sizeof(float3) : 0;
-	m_stride += numTexc ? sizeof(float[2]) : 0;
-	m_vertices.reserve(m_stride * (max)((max)(numVert, numTexc), numNorm));
-	m_vertices.resize(m_stride * numVert);
-	m_indices.resize(numIdx);
+	return true;
 }
 
-void ObjLoader::importGeometrySecondPass(FILE* pFile, uint32_t numTexc, uint32_t numNorm, bool forDX, bool swapYZ)
+void ObjLoader::parseGeometry(const char* pBegin, const char* pEnd, Geometry& geometry, bool forDX, bool swapYZ)
 {
-	auto numVert = 0u;
-	auto numTri = 0u;
-	char buffer[256] = { 0 };
+	geometry.NumTexcoords = 0;
 
-	vector<float3> normals;
-	vector<uint32_t> tIndices, nIndices;
-	if (numTexc) tIndices.resize(m_indices.size());
-	if (numNorm) nIndices.resize(m_indices.size());
-	normals.reserve(numNorm);
-
-	while (fscanf_s(pFile, "%s", buffer, static_cast<uint32_t>(sizeof(buffer))) != EOF)
+	for (auto p = pBegin; p < pEnd; p = skipLine(p, pEnd))
 	{
-		switch (buffer[0])
+		p = skipBlanks(p, pEnd);
+		if (pEnd - p < 2) continue;
+		const auto tagLength = p[0] == 'v' && (p[1] == 'n' || p[1] == 't') ? 2 : 1;
+		if (pEnd - p <= tagLength || !isBlank(p[tagLength])) continue;
+
+		switch (p[0])
 		{
-		case 'f': // v, v//vn, v/vt, or v/vt/vn.
-			loadIndices(pFile, numTri, numTexc, numNorm, nIndices, tIndices);
-			break;
 		case 'v': // v, vn, or vt.
-			switch (buffer[1])
-			{
-			case '\0': // v
+			switch (p[1])
 			{
-				auto& p = getPosition(numVert++);
-				fscanf_s(pFile, "%f %f %f", &p.x, &p.y, &p.z);
-				if (swapYZ)
-				{
-					const auto tmp = p.y;
-					p.y = p.z;
-					p.z = tmp;
-				}
-				p.z = forDX ? -p.z : p.z;
+			case 't':
+				++geometry.NumTexcoords;
 				break;
-			}
 			case 'n':
-				normals.emplace_back();
-				fscanf_s(pFile, "%f %f %f",
-					&normals.back().x,
-					&normals.back().y,
-					&normals.back().z);
+			default:
+			{
+				const auto isNormal = p[1] == 'n';
+				p += isNormal ? 2 : 1;
+
+				float3 v(0.0f, 0.0f, 0.0f);
+				parseFloat(p, pEnd, v.x) && parseFloat(p, pEnd, v.y) && parseFloat(p, pEnd, v.z);
 				if (swapYZ)
 				{
-					const auto tmp = normals.back().y;
-					normals.back().y = normals.back().z;
-					normals.back().z = tmp;
+					const auto tmp = v.y;
+					v.y = v.z;
+					v.z = tmp;
 				}
-				normals.back().z = forDX ? -normals.back().z : normals.back().z;
-			default:
+				v.z = forDX ? -v.z : v.z;
+
+				if (isNormal) geometry.Normals.emplace_back(v);
+				else geometry.Positions.emplace_back(v);
 				break;
 			}
+			}
 			break;
 
-		default:
-			fgets(buffer, sizeof(buffer), pFile);
-			break;
-		}
-	}
-
-	computePerVertexNormals(normals, nIndices);
-
-	if ((forDX && !swapYZ) || (!forDX && swapYZ)) reverse(m_indices.begin(), m_indices.end());
-}
-
-void ObjLoader::loadIndices(FILE* pFile, uint32_t& numTri, uint32_t numTexc,
-	uint32_t numNorm, vector<uint32_t>& nIndices, vector<uint32_t>& tIndices)
-{
-	int64_t vi;
-	uint32_t v[3] = { 0 };
-	uint32_t vt[3] = { 0 };
-	uint32_t vn[3] = { 0 };
-
-	const auto numVert = GetNumVertices();
-
-	for (uint8_t i = 0; i < 3; ++i)
-	{
-		fscanf_s(pFile, "%lld", &vi);
-		v[i] = static_cast<uint32_t>(vi < 0 ? vi + numVert : vi - 1);
-		m_indices[numTri * 3 + i] = v[i];
-
-		if (tIndices.size() > 0)
-		{
-			fscanf_s(pFile, "/%lld", &vi);
-			vt[i] = static_cast<uint32_t>(vi < 0 ? vi + numTexc : vi - 1);
-			tIndices[numTri * 3 + i] = vt[i];
-		}
-		else if (nIndices.size() > 0) fscanf_s(pFile, "/");
-
-		if (nIndices.size() > 0)
+		case 'f': // v, v//vn, v/vt, or v/vt/vn.
 		{
-			fscanf_s(pFile, "/%lld", &vi);
-			vn[i] = static_cast<uint32_t>(vi < 0 ? vi + numNorm : vi - 1);
-			nIndices[numTri * 3 + i] = vn[i];
-		}
-	}
-	++numTri;
+			const auto numVert = static_cast<int64_t>(geometry.Positions.size());
+			const auto numNorm = static_cast<int64_t>(geometry.Normals.size());
+
+			// Triangulate polygons as fans
+			uint32_t v[2] = { 0 };
+			uint32_t vn[2] = { 0 };
+			bool isRel[2] = { false };
+			bool isRelN[2] = { false };
+			auto numCorners = 0u;
+			int64_t vi, vti, vni;
+			for (++p; parseInt(p, pEnd, vi); ++numCorners)
+			{
+				vni = 0;
+				if (p < pEnd && *p == '/')
+				{
+					++p;
+					parseInt(p, pEnd, vti);
+					if (p < pEnd && *p == '/') parseInt(++p, pEnd, vni);
+				}
 
-	v[1] = v[2];
-	vt[1] = vt[2];
-	vn[1] = vn[2];
+				const auto i = static_cast<uint32_t>(vi < 0 ? vi + numVert : vi - 1);
+				const auto ni = vni == 0 ? UINT32_MAX : static_cast<uint32_t>(vni < 0 ? vni + numNorm : vni - 1);
+				if (numCorners < 2)
+				{
+					v[numCorners] = i;
+					vn[numCorners] = ni;
+					isRel[numCorners] = vi < 0;
+					isRelN[numCorners] = vni < 0;
+					continue;
+				}
 
-	while (fscanf_s(pFile, "%lld", &vi) > 0)
-	{
-		v[2] = static_cast<uint32_t>(vi < 0 ? vi + numVert : vi - 1);
-		m_indices[numTri * 3] = v[0];
-		m_indices[numTri * 3 + 1] = v[1];
-		m_indices[numTri * 3 + 2] = v[2];
-		v[1] = v[2];
+				const auto idx = static_cast<uint32_t>(geometry.Indices.size());
+				const bool isRelTri[] = { isRel[0], isRel[1], vi < 0 };
+				const bool isRelNTri[] = { isRelN[0], isRelN[1], vni < 0 };
+				for (uint8_t j = 0; j < 3; ++j)
+				{
+					if (isRelTri[j]) geometry.RelIndices.emplace_back(idx + j);
+					if (isRelNTri[j]) geometry.RelNIndices.emplace_back(idx + j);
+				}
 
-		if (tIndices.size() > 0)
-		{
-			fscanf_s(pFile, "/%lld", &vi);
-			vt[2] = static_cast<uint32_t>(vi < 0 ? vi + numTexc : vi - 1);
-			tIndices[numTri * 3] = vt[0];
-			tIndices[numTri * 3 + 1] = vt[1];
-			tIndices[numTri * 3 + 2] = vt[2];
-			vt[1] = vt[2];
+				geometry.Indices.insert(geometry.Indices.end(), { v[0], v[1], i });
+				geometry.NIndices.insert(geometry.NIndices.end(), { vn[0], vn[1], ni });
+				v[1] = i;
+				vn[1] = ni;
+				isRel[1] = vi < 0;
+				isRelN[1] = vni < 0;
+			}
+			break;
 		}
-		else if (nIndices.size() > 0) fscanf_s(pFile, "/");
-
-		if (nIndices.size() > 0)
-		{
-			fscanf_s(pFile, "/%lld", &vi);
-			vn[2] = static_cast<uint32_t>(vi < 0 ? vi + numNorm : vi - 1);
-			nIndices[numTri * 3] = vn[0];
-			nIndices[numTri * 3 + 1] = vn[1];
-			nIndices[numTri * 3 + 2] = vn[2];
-			vn[1] = vn[2];
 		}
-
-		++numTri;
 	}
 }
 
@@ -308,7 +431,7 @@ void ObjLoader::computePerVertexNormals(const vector<float3>& normals, const vec
 	for (auto i = 0u; i < numIdx; i++)
 	{
 		auto vi = m_indices[i];
-		if (vni[vi] == nIndices[i]) continue;
+		if (vni[vi] == nIndices[i] || nIndices[i] >= normals.size()) continue;
 
 		if (vni[vi] < UINT32_MAX)
 		{
@@ -336,83 +459,170 @@ void ObjLoader::computePerVertexNormals(const vector<float3>& normals, const vec
 
 void ObjLoader::recomputeNormals()
 {
-	float3 e1, e2, n;
-
 	const auto numTri = static_cast<uint32_t>(m_indices.size()) / 3;
-	for (auto i = 0u; i < numTri; i++)
+	const auto numVert = GetNumVertices();
+
+	// Face normals
+	vector<float3> faceNormals(numTri);
+	m_threadPool->ParallelFor((numTri + ElementsPerTask - 1) / ElementsPerTask, [&](uint32_t task)
 	{
-		const auto pv0 = &getPosition(m_indices[i * 3]);
-		const auto pv1 = &getPosition(m_indices[i * 3 + 1]);
-		const auto pv2 = &getPosition(m_indices[i * 3 + 2]);
-		e1.x = pv1->x - pv0->x;
-		e1.y = pv1->y - pv0->y;
-		e1.z = pv1->z - pv0->z;
-		e2.x = pv2->x - pv1->x;
-		e2.y = pv2->y - pv1->y;
-		e2.z = pv2->z - pv1->z;
-		n.x = e1.y * e2.z - e1.z * e2.y;
-		n.y = e1.z * e2.x - e1.x * e2.z;
-		n.z = e1.x * e2.y - e1.y * e2.x;
-		const auto l = sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
-		n.x /= l;
-		n.y /= l;
-		n.z /= l;
+		float3 e1, e2, n;
 
-		const auto pVn0 = &getNormal(m_indices[i * 3]);
-		const auto pVn1 = &getNormal(m_indices[i * 3 + 1]);
-		const auto pVn2 = &getNormal(m_indices[i * 3 + 2]);
-		pVn0->x += n.x;
-		pVn0->y += n.y;
-		pVn0->z += n.z;
-		pVn1->x += n.x;
-		pVn1->y += n.y;
-		pVn1->z += n.z;
-		pVn2->x += n.x;
-		pVn2->y += n.y;
-		pVn2->z += n.z;
-	}
+		const auto end = (min)(ElementsPerTask * (task + 1), numTri);
+		for (auto i = ElementsPerTask * task; i < end; ++i)
+		{
+			const auto pv0 = &getPosition(m_indices[i * 3]);
+			const auto pv1 = &getPosition(m_indices[i * 3 + 1]);
+			const auto pv2 = &getPosition(m_indices[i * 3 + 2]);
+			e1.x = pv1->x - pv0->x;
+			e1.y = pv1->y - pv0->y;
+			e1.z = pv1->z - pv0->z;
+			e2.x = pv2->x - pv1->x;
+			e2.y = pv2->y - pv1->y;
+			e2.z = pv2->z - pv1->z;
+			n.x = e1.y * e2.z - e1.z * e2.y;
+			n.y = e1.z * e2.x - e1.x * e2.z;
+			n.z = e1.x * e2.y - e1.y * e2.x;
+			const auto l = sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+			n.x /= l;
+			n.y /= l;
+			n.z /= l;
+			faceNormals[i] = n;
+		}
+	});
 
-	const auto numVert = GetNumVertices();
-	for (auto i = 0u; i < numVert; ++i)
+	// Vertex-triangle adjacency in the triangle order, so that each vertex gathers its
+	// face normals in the same order as a serial accumulation, without atomics
+	vector<uint32_t> adjOffsets(numVert + 1);
+	for (const auto& i : m_indices) ++adjOffsets[i + 1];
+	for (auto i = 0u; i < numVert; ++i) adjOffsets[i + 1] += adjOffsets[i];
+
+	vector<uint32_t> adjacency(numTri * 3);
 	{
-		const auto pVn = &getNormal(i);
-		const auto l = sqrt(pVn->x * pVn->x + pVn->y * pVn->y + pVn->z * pVn->z);
-		pVn->x /= l;
-		pVn->y /= l;
-		pVn->z /= l;
+		vector<uint32_t> cursors(adjOffsets.cbegin(), adjOffsets.cend() - 1);
+		for (auto i = 0u; i < numTri * 3; ++i) adjacency[cursors[m_indices[i]]++] = i / 3;
 	}
+
+	// Gather and normalize the vertex normals
+	m_threadPool->ParallelFor((numVert + ElementsPerTask - 1) / ElementsPerTask, [&](uint32_t task)
+	{
+		const auto end = (min)(ElementsPerTask * (task + 1), numVert);
+		for (auto i = ElementsPerTask * task; i < end; ++i)
+		{
+			const auto pVn = &getNormal(i);
+			for (auto j = adjOffsets[i]; j < adjOffsets[i + 1]; ++j)
+			{
+				const auto& n = faceNormals[adjacency[j]];
+				pVn->x += n.x;
+				pVn->y += n.y;
+				pVn->z += n.z;
+			}
+
+			const auto l = sqrt(pVn->x * pVn->x + pVn->y * pVn->y + pVn->z * pVn->z);
+			pVn->x /= l;
+			pVn->y /= l;
+			pVn->z /= l;
+		}
+	});
 }
 
 void ObjLoader::computeAABB()
 {
-	float xMax, xMin, yMax, yMin, zMax, zMin;
-	const auto& p = getPosition(0);
-	xMax = xMin = p.x;
-	yMax = yMin = p.y;
-	zMax = zMin = p.z;
-
-	auto x = 0.0f, y = 0.0f, z = 0.0f;
-
 	const auto numVert = GetNumVertices();
-	for (auto i = 1u; i < numVert; ++i)
+	const auto numTasks = (numVert + ElementsPerTask - 1) / ElementsPerTask;
+
+	// Partial bounds of the vertex ranges, merged in order
+	vector<AABB> partials(numTasks);
+	m_threadPool->ParallelFor(numTasks, [&](uint32_t task)
 	{
-		const auto& p = getPosition(i);
-		x = p.x;
-		y = p.y;
-		z = p.z;
+		const auto begin = ElementsPerTask * task;
+		const auto end = (min)(begin + ElementsPerTask, numVert);
+#if defined(_M_X64) || defined(__x86_64__)
+		// 4-wide loads read one float past the position, which stays within the
+		// buffer except for the last vertex with a 12-byte stride
+		const auto vectorEnd = m_stride >= sizeof(float[4]) || end < numVert ? end : end - 1;
+		const auto loadPosition = [&](uint32_t i)
+		{
+			const auto p = &getPosition(i);
+			return i < vectorEnd ? _mm_loadu_ps(&p->x) : _mm_setr_ps(p->x, p->y, p->z, p->z);
+		};
+
+		// The new value is the first operand, so that NaN positions are skipped
+		auto vMin = loadPosition(begin);
+		auto vMax = vMin;
+		for (auto i = begin + 1; i < end; ++i)
+		{
+			const auto v = loadPosition(i);
+			vMin = _mm_min_ps(v, vMin);
+			vMax = _mm_max_ps(v, vMax);
+		}
 
-		if (x < xMin) xMin = x;
-		else if (x > xMax) xMax = x;
+		float minMax[2][4];
+		_mm_storeu_ps(minMax[0], vMin);
+		_mm_storeu_ps(minMax[1], vMax);
+		partials[task].Min = float3(minMax[0]);
+		partials[task].Max = float3(minMax[1]);
+#else
+		auto& aabb = partials[task];
+		aabb.Min = aabb.Max = getPosition(begin);
+		for (auto i = begin + 1; i < end; ++i)
+		{
+			const auto& p = getPosition(i);
+			aabb.Min = float3((min)(aabb.Min.x, p.x), (min)(aabb.Min.y, p.y), (min)(aabb.Min.z, p.z));
+			aabb.Max = float3((max)(aabb.Max.x, p.x), (max)(aabb.Max.y, p.y), (max)(aabb.Max.z, p.z));
+		}
+#endif
+	});
 
-		if (y < yMin) yMin = y;
-		else if (y > yMax) yMax = y;
+	m_aabb = partials[0];
+	for (auto i = 1u; i < numTasks; ++i)
+	{
+		const auto& aabb = partials[i];
+		m_aabb.Min = float3((min)(m_aabb.Min.x, aabb.Min.x), (min)(m_aabb.Min.y, aabb.Min.y), (min)(m_aabb.Min.z, aabb.Min.z));
+		m_aabb.Max = float3((max)(m_aabb.Max.x, aabb.Max.x), (max)(m_aabb.Max.y, aabb.Max.y), (max)(m_aabb.Max.z, aabb.Max.z));
+	}
+}
 
-		if (z < zMin) zMin = z;
-		else if (z > zMax) zMax = z;
+bool ObjLoader::loadCache(const char* fileName, const CacheHeader& expected)
+{
+	if (!m_cacheFile.Open(fileName)) return false;
+
+	const auto pHeader = reinterpret_cast<const CacheHeader*>(m_cacheFile.GetData());
+	if (m_cacheFile.GetSize() < sizeof(CacheHeader) ||
+		memcmp(pHeader->Magic, expected.Magic, sizeof(pHeader->Magic)) != 0 ||
+		pHeader->Version != expected.Version || pHeader->Flags != expected.Flags ||
+		pHeader->SourceSize != expected.SourceSize || pHeader->SourceTime != expected.SourceTime ||
+		pHeader->Stride < sizeof(float3) || pHeader->Stride % sizeof(float) != 0 ||
+		m_cacheFile.GetSize() < sizeof(CacheHeader) + static_cast<uint64_t>(pHeader->Stride) * pHeader->NumVertices +
+		sizeof(uint32_t) * static_cast<uint64_t>(pHeader->NumIndices))
+	{
+		m_cacheFile.Close();
+		return false;
 	}
 
-	m_aabb.Min = float3(xMin, yMin, zMin);
-	m_aabb.Max = float3(xMax, yMax, zMax);
+	vector<uint8_t>().swap(m_vertices);
+	vector<uint32_t>().swap(m_indices);
+	m_stride = pHeader->Stride;
+	m_aabb = pHeader->BoundingBox;
+	m_pCache = pHeader;
+
+	return true;
+}
+
+bool ObjLoader::saveCache(const char* fileName, CacheHeader header) const
+{
+	header.Stride = m_stride;
+	header.NumVertices = GetNumVertices();
+	header.NumIndices = GetNumIndices();
+
+	ofstream file(fileName, ios::out | ios::binary);
+	if (!file) return false;
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+	file.write(reinterpret_cast<const char*>(GetVertices()), m_stride * header.NumVertices);
+	file.write(reinterpret_cast<const char*>(GetIndices()), sizeof(uint32_t) * header.NumIndices);
+
+	return file.good();
 }
 
 void* ObjLoader::getVertex(uint32_t i)
@@ -4,6 +4,11 @@
 
 #pragma once
 
+#include <memory>
+#include "XUSGMappedFile.h"
+#include "XUSGMeshOptimizer.h"
+#include "XUSGThreadPool.h"
+
 namespace XUSG
 {
 	class ObjLoader
@@ -28,11 +33,19 @@ namespace XUSG
 			float3 Max;
 		};
 
-		ObjLoader();
+		// Large files are split at line boundaries and parsed on numThreads threads,
+		// 0 for the hardware concurrency. With useCache, the imported mesh is saved to
+		// a binary sidecar (<file>.<flags>.xmesh), which is memory-mapped by later imports
+		// of the same unmodified file with the same flags. Each set of flags has its own
+		// sidecar, so importers of the same file with different flags all hit the cache.
+		ObjLoader(uint32_t numThreads = 0, bool useCache = true);
 		virtual ~ObjLoader();
 
+		// With optimize, identical vertices are welded, and the triangles and vertices are
+		// reordered for the post-transform cache and for fetch locality.
 		bool Import(const char* pszFilename, bool needNorm = true,
-			bool needAABB = true, bool forDX = true, bool swapYZ = false);
+			bool needAABB = true, bool forDX = true, bool swapYZ = false,
+			bool optimize = false);
 
 		const uint32_t GetNumVertices() const;
 		const uint32_t GetNumIndices() const;
@@ -42,19 +55,64 @@ namespace XUSG
 
 		const AABB& GetAABB() const;
 
+		// Vertex cache statistics of the last optimized import, false if it was not
+		// optimized or was loaded from the cache
+		bool GetOptimizationStats(MeshOptimizer::Stats& before, MeshOptimizer::Stats& after) const;
+
 	protected:
-		void importGeometryFirstPass(FILE* pFile, uint32_t& numTexc, uint32_t& numNorm);
-		void importGeometrySecondPass(FILE* pFile, uint32_t numTexc, uint32_t numNorm, bool forDX, bool swapYZ);
-		void loadIndices(FILE* pFile, uint32_t& numTri, uint32_t numTexc, uint32_t numNorm,
-			std::vector<uint32_t>& nIndices, std::vector<uint32_t>& tIndices);
+		static const uint32_t MinChunkSize = 1 << 20;
+		static const uint32_t ElementsPerTask = 1 << 14;
+		static const uint32_t CacheVersion = 1;
+
+		// Followed by the interleaved vertices and the indices
+		struct CacheHeader
+		{
+			char Magic[4];
+			uint32_t Version;
+			uint32_t Flags;			// needNorm, needAABB, forDX, swapYZ, and optimize
+			uint32_t Stride;
+			uint64_t SourceSize;
+			uint64_t SourceTime;
+			uint32_t NumVertices;
+			uint32_t NumIndices;
+			AABB BoundingBox;
+		};
+
+		// Geometry streams of a chunk as parsed, before the vertices are interleaved.
+		// Negative (relative) indices are resolved against the chunk-local counts; their
+		// positions are recorded, so that the bases of the preceding chunks can be added.
+		struct Geometry
+		{
+			std::vector<float3>		Positions;
+			std::vector<float3>		Normals;
+			std::vector<uint32_t>	Indices;
+			std::vector<uint32_t>	NIndices;
+			std::vector<uint32_t>	RelIndices;
+			std::vector<uint32_t>	RelNIndices;
+			uint32_t				NumTexcoords;
+		};
+
+		void parseGeometry(const char* pBegin, const char* pEnd, Geometry& geometry, bool forDX, bool swapYZ);
 		void computePerVertexNormals(const std::vector<float3>& normals, const std::vector<uint32_t>& nIndices);
 		void recomputeNormals();
 		void computeAABB();
 
+		bool loadCache(const char* fileName, const CacheHeader& expected);
+		bool saveCache(const char* fileName, CacheHeader header) const;
+
 		void* getVertex(uint32_t i);
 		float3& getPosition(uint32_t i);
 		float3& getNormal(uint32_t i);
 
+		std::unique_ptr<ThreadPool> m_threadPool;
+
+		MappedFile				m_cacheFile;
+		const CacheHeader*		m_pCache;
+		bool					m_useCache;
+
+		MeshOptimizer::Stats	m_optimizationStats[2];
+		bool					m_isOptimized;
+
 		std::vector<uint8_t>	m_vertices;
 		std::vector<uint32_t>	m_indices;
 
@@ -0,0 +1,212 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include "XUSGSHBasisTable.h"
+
+#define PI 3.1415926535897
+
+using namespace std;
+using namespace XUSG;
+using namespace SH;
+
+namespace
+{
+	template<uint32_t Order>
+	struct BasisTableKernel
+	{
+		static void Run(float* pTable, uint32_t mapSize, uint32_t texelBegin, uint32_t texelEnd)
+		{
+			const auto sliceSize = mapSize * mapSize;
+			for (auto i = texelBegin; i < texelEnd; ++i)
+			{
+				const auto xy = i % sliceSize;
+				const auto x = xy % mapSize;
+				const auto y = xy / mapSize;
+				const auto slice = static_cast<uint8_t>(i / sliceSize);
+
+				const auto dir = GetCubeTexcoord(x, y, slice, mapSize);
+				const auto l = sqrt(dir.x * dir.x + dir.y * dir.y + dir.z * dir.z);
+
+				float basis[Order * Order];
+				SHEvalBasis<Order>(basis, dir.x / l, dir.y / l, dir.z / l);
+				SHScale<Order>(&pTable[Order * Order * i], basis, GetDiffSolid(x, y, mapSize));
+			}
+		}
+	};
+}
+
+//--------------------------------------------------------------------------------------
+// Basis table
+//--------------------------------------------------------------------------------------
+BasisTable::BasisTable() :
+	m_pData(nullptr),
+	m_mapSize(0),
+	m_order(0)
+{
+}
+
+BasisTable::~BasisTable()
+{
+}
+
+bool BasisTable::Create(uint32_t mapSize, uint8_t order, uint32_t numThreads)
+{
+	if (mapSize == 0 || order < 2 || order > SH_MAX_ORDER) return false;
+
+	m_file.Close();
+	m_mapSize = mapSize;
+	m_order = order;
+
+	const auto numTexels = GetNumTexels();
+	const auto numCoeffs = order * order;
+	m_table.resize(static_cast<size_t>(numCoeffs) * numTexels);
+	m_pData = m_table.data();
+
+	// Fill the texel rows in parallel
+	if (numThreads == 0) numThreads = (max)(thread::hardware_concurrency(), 1u);
+	numThreads = (min)(numThreads, numTexels);
+	const auto texelsPerThread = (numTexels + numThreads - 1) / numThreads;
+
+	vector<thread> workers;
+	for (auto i = 0u; i < numThreads; ++i)
+	{
+		const auto texelBegin = texelsPerThread * i;
+		const auto texelEnd = (min)(texelBegin + texelsPerThread, numTexels);
+		workers.emplace_back([=]()
+		{
+			SHDispatch<BasisTableKernel>(order, m_table.data(), mapSize, texelBegin, texelEnd);
+		});
+	}
+	for (auto& worker : workers) worker.join();
+
+	// Fold the normalization of CSSHNormalize.hlsl into the table
+	auto wt = 0.0;
+	for (auto y = 0u; y < mapSize; ++y)
+		for (auto x = 0u; x < mapSize; ++x)
+			wt += GetDiffSolid(x, y, mapSize);
+	wt *= 6.0;
+
+	const auto normProj = static_cast<float>(4.0 * PI / wt);
+	for (auto& value : m_table) value *= normProj;
+
+	return true;
+}
+
+bool BasisTable::Load(const char* fileName)
+{
+	m_table.clear();
+	m_pData = nullptr;
+	if (!m_file.Open(fileName)) return false;
+
+	Header header;
+	if (m_file.GetSize() < sizeof(Header))
+	{
+		m_file.Close();
+		return false;
+	}
+	memcpy(&header, m_file.GetData(), sizeof(Header));
+
+	// Check the map size before the products, so that they cannot overflow
+	if (memcmp(header.Magic, "SHBT", sizeof(header.Magic)) != 0 || header.Version != Version ||
+		header.Order < 2 || header.Order > SH_MAX_ORDER || header.MapSize == 0 || header.MapSize > MaxMapSize ||
+		header.NumTexels != 6ull * header.MapSize * header.MapSize ||
+		m_file.GetSize() < sizeof(Header) + sizeof(float) * header.Order * header.Order * header.NumTexels)
+	{
+		m_file.Close();
+		return false;
+	}
+
+	m_mapSize = header.MapSize;
+	m_order = static_cast<uint8_t>(header.Order);
+	m_pData = reinterpret_cast<const float*>(m_file.GetData() + sizeof(Header));
+
+	return true;
+}
+
+bool BasisTable::Save(const char* fileName) const
+{
+	if (!m_pData) return false;
+
+	Header header = {};
+	memcpy(header.Magic, "SHBT", sizeof(header.Magic));
+	header.Version = Version;
+	header.MapSize = m_mapSize;
+	header.Order = m_order;
+	header.NumTexels = GetNumTexels();
+
+	ofstream file(fileName, ios::out | ios::binary);
+	if (!file) return false;
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+	file.write(reinterpret_cast<const char*>(m_pData), sizeof(float) * m_order * m_order * header.NumTexels);
+
+	return file.good();
+}
+
+const float* BasisTable::GetData() const
+{
+	return m_pData;
+}
+
+const float* BasisTable::GetRow(uint32_t texel) const
+{
+	return &m_pData[m_order * m_order * texel];
+}
+
+uint32_t BasisTable::GetMapSize() const
+{
+	return m_mapSize;
+}
+
+uint32_t BasisTable::GetNumTexels() const
+{
+	return m_mapSize * m_mapSize * 6;
+}
+
+uint8_t BasisTable::GetOrder() const
+{
+	return m_order;
+}
+
+//--------------------------------------------------------------------------------------
+// Basis table cache
+//--------------------------------------------------------------------------------------
+BasisTableCache::BasisTableCache(const char* directory, uint32_t numThreads) :
+	m_directory(directory ? directory : ""),
+	m_numThreads(numThreads)
+{
+}
+
+BasisTableCache::~BasisTableCache()
+{
+}
+
+const BasisTable* BasisTableCache::GetTable(uint32_t mapSize, uint8_t order)
+{
+	const auto key = (mapSize << 8) | order;
+	auto& table = m_tables[key];
+	if (table) return table.get();
+
+	table = unique_ptr<BasisTable>(new BasisTable);
+	if (!m_directory.empty())
+	{
+		const auto fileName = m_directory + "/SHBasis_" + to_string(mapSize) + "_" + to_string(order) + ".bin";
+		if (table->Load(fileName.c_str())) return table.get();
+		if (table->Create(mapSize, order, m_numThreads))
+		{
+			table->Save(fileName.c_str());
+			return table.get();
+		}
+	}
+	else if (table->Create(mapSize, order, m_numThreads)) return table.get();
+
+	m_tables.erase(key);
+
+	return nullptr;
+}
@@ -0,0 +1,75 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "XUSGMappedFile.h"
+#include "XUSGSHMath.h"
+
+namespace XUSG
+{
+	namespace SH
+	{
+		// Per-texel SH basis pre-multiplied by the differential solid angle and the
+		// 4pi/sum(w) normalization of CSSHNormalize.hlsl, stored texel-major as
+		// float[numTexels][order * order]. Projection reduces to radiance x table.
+		class BasisTable
+		{
+		public:
+			BasisTable();
+			virtual ~BasisTable();
+
+			bool Create(uint32_t mapSize, uint8_t order, uint32_t numThreads = 0);
+			bool Load(const char* fileName);
+			bool Save(const char* fileName) const;
+
+			const float* GetData() const;
+			const float* GetRow(uint32_t texel) const;
+			uint32_t GetMapSize() const;
+			uint32_t GetNumTexels() const;
+			uint8_t GetOrder() const;
+
+		protected:
+			struct Header
+			{
+				char Magic[4];
+				uint32_t Version;
+				uint32_t MapSize;
+				uint32_t Order;
+				uint64_t NumTexels;
+				uint8_t Reserved[40];	// Pads the table data to a 64-byte boundary
+			};
+
+			static const uint32_t Version = 1;
+			static const uint32_t MaxMapSize = 16384;	// Bounds the sizes from file headers
+
+			std::vector<float>	m_table;
+			MappedFile			m_file;
+
+			const float*		m_pData;
+			uint32_t			m_mapSize;
+			uint8_t				m_order;
+		};
+
+		// Lazily created tables keyed by (mapSize, order), optionally memory-mapped
+		// from (and saved to) a directory so that later runs skip the precomputation.
+		class BasisTableCache
+		{
+		public:
+			BasisTableCache(const char* directory = nullptr, uint32_t numThreads = 0);
+			virtual ~BasisTableCache();
+
+			const BasisTable* GetTable(uint32_t mapSize, uint8_t order);
+
+		protected:
+			std::map<uint32_t, std::unique_ptr<BasisTable>> m_tables;
+			std::string	m_directory;
+			uint32_t	m_numThreads;
+		};
+	}
+}
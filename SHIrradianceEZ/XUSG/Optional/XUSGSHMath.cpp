@@ -0,0 +1,345 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <cmath>
+#include <cstring>
+#if defined(_M_X64) || defined(__x86_64__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+#endif
+#include "XUSGSHMathSoA.h"
+
+using namespace std;
+using namespace XUSG;
+
+namespace
+{
+	struct float1
+	{
+		float v;
+
+		float1() = default;
+		explicit float1(float s) : v(s) {}
+
+		static float1 Load(const float* p) { return float1(*p); }
+		void Store(float* p) const { *p = v; }
+	};
+
+	inline float1 operator+(const float1& a, const float1& b) { return float1(a.v + b.v); }
+	inline float1 operator-(const float1& a, const float1& b) { return float1(a.v - b.v); }
+	inline float1 operator*(const float1& a, const float1& b) { return float1(a.v * b.v); }
+	inline float1 Max(const float1& a, const float1& b) { return float1(a.v > b.v ? a.v : b.v); }
+
+	const float Pi = 3.14159265358979323846f;
+
+	template<uint32_t Order>
+	struct SHEvalDirectionKernel
+	{
+		static void Run(float* pResult, const SH::float3& dir) { SH::SHEvalBasis<Order>(pResult, dir.x, dir.y, dir.z); }
+	};
+
+	template<uint32_t Order>
+	struct SHScaleKernel
+	{
+		static void Run(float* pResult, const float* pInput, float scale) { SH::SHScale<Order>(pResult, pInput, scale); }
+		static void Run(SH::float3* pResult, const float* pInput, const SH::float3& scale) { SH::SHScale<Order>(pResult, pInput, scale); }
+	};
+
+	SH::SIMDLevel detectSIMDLevel()
+	{
+#if defined(_M_X64) || defined(__x86_64__)
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return SH::SIMD_LEVEL_SCALAR;
+
+		__cpuid(info, 1);
+		const auto hasFMA = (info[2] & (1 << 12)) != 0;
+		const auto hasOSXSAVE = (info[2] & (1 << 27)) != 0;
+		if (!hasFMA || !hasOSXSAVE) return SH::SIMD_LEVEL_SCALAR;
+
+		// The OS must preserve the YMM (and ZMM) states
+		const auto xcr0 = _xgetbv(0);
+		__cpuidex(info, 7, 0);
+		const auto hasAVX2 = (info[1] & (1 << 5)) != 0 && (xcr0 & 0x06) == 0x06;
+		const auto hasAVX512 = (info[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6;
+#else
+		__builtin_cpu_init();
+		const auto hasAVX2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+		const auto hasAVX512 = __builtin_cpu_supports("avx512f");
+#endif
+		if (hasAVX512) return SH::SIMD_LEVEL_AVX512;
+		if (hasAVX2) return SH::SIMD_LEVEL_AVX2;
+
+		return SH::SIMD_LEVEL_SCALAR;
+#elif defined(_M_ARM64) || defined(__aarch64__)
+		return SH::SIMD_LEVEL_NEON;
+#else
+		return SH::SIMD_LEVEL_SCALAR;
+#endif
+	}
+}
+
+void SH::sh_eval_basis_1(const float3& v, float b[4])
+{
+	SHEvalBasis<2>(b, v.x, v.y, v.z);
+}
+
+void SH::sh_eval_basis_2(const float3& v, float b[9])
+{
+	SHEvalBasis<3>(b, v.x, v.y, v.z);
+}
+
+void SH::sh_eval_basis_3(const float3& v, float b[16])
+{
+	SHEvalBasis<4>(b, v.x, v.y, v.z);
+}
+
+void SH::sh_eval_basis_4(const float3& v, float b[25])
+{
+	SHEvalBasis<5>(b, v.x, v.y, v.z);
+}
+
+void SH::sh_eval_basis_5(const float3& v, float b[36])
+{
+	SHEvalBasis<6>(b, v.x, v.y, v.z);
+}
+
+void SH::SHEvalDirection(float result[MaxCoeffCount], uint8_t order, const float3& dir)
+{
+	SHDispatch<SHEvalDirectionKernel>(order, result, dir);
+}
+
+void SH::SHEvalDirections(float* pResult, size_t resultPitch, uint8_t order,
+	const float* pX, const float* pY, const float* pZ, uint32_t numDirs)
+{
+	static const auto simdLevel = GetSIMDLevel();
+	SHEvalDirections(pResult, resultPitch, order, pX, pY, pZ, numDirs, simdLevel);
+}
+
+void SH::SHEvalDirections(float* pResult, size_t resultPitch, uint8_t order,
+	const float* pX, const float* pY, const float* pZ, uint32_t numDirs, SIMDLevel simdLevel)
+{
+	switch (simdLevel)
+	{
+#if defined(_M_X64) || defined(__x86_64__)
+	case SIMD_LEVEL_AVX512:
+		SHEvalDirectionsAVX512(pResult, resultPitch, order, pX, pY, pZ, numDirs);
+		break;
+	case SIMD_LEVEL_AVX2:
+		SHEvalDirectionsAVX2(pResult, resultPitch, order, pX, pY, pZ, numDirs);
+		break;
+#elif defined(_M_ARM64) || defined(__aarch64__)
+	case SIMD_LEVEL_NEON:
+		SHEvalDirectionsNEON(pResult, resultPitch, order, pX, pY, pZ, numDirs);
+		break;
+#endif
+	default:
+		SHEvalDirectionsScalar(pResult, resultPitch, order, pX, pY, pZ, numDirs);
+	}
+}
+
+void SH::SHEvalDirectionsScalar(float* pResult, size_t resultPitch, uint8_t order,
+	const float* pX, const float* pY, const float* pZ, uint32_t numDirs)
+{
+	SHEvalDirectionsSoA<float1, 1>::Run(pResult, resultPitch, order, pX, pY, pZ, numDirs);
+}
+
+float SH::SHCosineLobe(uint32_t l)
+{
+	if (l == 0) return Pi;
+	if (l == 1) return 2.0f * Pi / 3.0f;
+	if (l & 1) return 0.0f;
+
+	// 2pi (-1)^(l/2 - 1) / ((l + 2)(l - 1)) * l! / (2^l ((l/2)!)^2)
+	const auto n = l / 2;
+	auto binomial = 1.0;	// l! / ((l/2)!)^2 / 2^l
+	for (auto i = 1u; i <= n; ++i) binomial *= (n + i) / (4.0 * i);
+	const auto sign = n & 1 ? 1.0 : -1.0;
+
+	return static_cast<float>(2.0 * Pi * sign / ((l + 2.0) * (l - 1.0)) * binomial);
+}
+
+float SH::SHWindowWeight(uint32_t l, uint8_t order, Window window)
+{
+	const auto x = Pi * l / order;
+	switch (window)
+	{
+	case WINDOW_HANNING:
+		return 0.5f * (1.0f + cos(x));
+	case WINDOW_LANCZOS:
+		return l > 0 ? sin(x) / x : 1.0f;
+	default:
+		return 1.0f;
+	}
+}
+
+void SH::SHConvolveIrradiance(float3 result[MaxCoeffCount], uint8_t order,
+	const float3 input[MaxCoeffCount], Window window)
+{
+	for (auto l = 0u; l < order; ++l)
+	{
+		const auto scale = SHCosineLobe(l) * SHWindowWeight(l, order, window);
+		for (auto k = l * l; k < (l + 1) * (l + 1); ++k)
+			result[k] = float3(input[k].x * scale, input[k].y * scale, input[k].z * scale);
+	}
+}
+
+void SH::SHEvalIrradiance(float* pResult, size_t resultPitch, uint8_t order, const float3 coeffs[MaxCoeffCount],
+	const float* pX, const float* pY, const float* pZ, uint32_t numDirs)
+{
+	static const auto simdLevel = GetSIMDLevel();
+	SHEvalIrradiance(pResult, resultPitch, order, coeffs, pX, pY, pZ, numDirs, simdLevel);
+}
+
+void SH::SHEvalIrradiance(float* pResult, size_t resultPitch, uint8_t order, const float3 coeffs[MaxCoeffCount],
+	const float* pX, const float* pY, const float* pZ, uint32_t numDirs, SIMDLevel simdLevel)
+{
+	switch (simdLevel)
+	{
+#if defined(_M_X64) || defined(__x86_64__)
+	case SIMD_LEVEL_AVX512:
+		SHEvalIrradianceAVX512(pResult, resultPitch, order, coeffs, pX, pY, pZ, numDirs);
+		break;
+	case SIMD_LEVEL_AVX2:
+		SHEvalIrradianceAVX2(pResult, resultPitch, order, coeffs, pX, pY, pZ, numDirs);
+		break;
+#elif defined(_M_ARM64) || defined(__aarch64__)
+	case SIMD_LEVEL_NEON:
+		SHEvalIrradianceNEON(pResult, resultPitch, order, coeffs, pX, pY, pZ, numDirs);
+		break;
+#endif
+	default:
+		SHEvalIrradianceScalar(pResult, resultPitch, order, coeffs, pX, pY, pZ, numDirs);
+	}
+}
+
+void SH::SHEvalIrradianceScalar(float* pResult, size_t resultPitch, uint8_t order, const float3* pCoeffs,
+	const float* pX, const float* pY, const float* pZ, uint32_t numDirs)
+{
+	SHEvalIrradianceSoA<float1, 1>::Run(pResult, resultPitch, order, pCoeffs, pX, pY, pZ, numDirs);
+}
+
+void SH::SHFoldIrradianceL2(float3 result[9], const float3 input[9], bool isHair)
+{
+	// Constants of the shader: 4 * A2 * Y22, 1/2 * A1 * Y10, A2 * Y20, and A0 * Y00,
+	// where the hair lobe scales the A_l by pi/2
+	const auto s = isHair ? 0.5f * Pi : 1.0f;
+	const auto c1 = 0.42904276540489171563379376569857f * s;
+	const auto c2 = 0.51166335397324424423977581244463f * s;
+	const auto c3 = 0.24770795610037568833406429782001f * s;
+	const auto c4 = 0.88622692545275801364908374167057f * s;
+
+	// The shader evaluates at (-x, -y, z)
+	const float k[] = { c4, -2.0f * c2, -2.0f * c2, 2.0f * c2, 2.0f * c1, -2.0f * c1, -2.0f * c1, c1, 3.0f * c3 };
+	const uint8_t src[] = { 0, 3, 1, 2, 4, 5, 7, 8, 6 };
+	for (uint8_t i = 0; i < 9; ++i)
+	{
+		const auto& c = input[src[i]];
+		result[i] = float3(k[i] * c.x, k[i] * c.y, k[i] * c.z);
+	}
+
+	// c3 * L20 * (3z^2 - 1)
+	result[0].x -= c3 * input[6].x;
+	result[0].y -= c3 * input[6].y;
+	result[0].z -= c3 * input[6].z;
+}
+
+void SH::SHEvalIrradianceL2(float* pResult, size_t resultPitch, const float3 polyCoeffs[9],
+	const float* pX, const float* pY, const float* pZ, uint32_t numDirs)
+{
+	static const auto simdLevel = GetSIMDLevel();
+	SHEvalIrradianceL2(pResult, resultPitch, polyCoeffs, pX, pY, pZ, numDirs, simdLevel);
+}
+
+void SH::SHEvalIrradianceL2(float* pResult, size_t resultPitch, const float3 polyCoeffs[9],
+	const float* pX, const float* pY, const float* pZ, uint32_t numDirs, SIMDLevel simdLevel)
+{
+	switch (simdLevel)
+	{
+#if defined(_M_X64) || defined(__x86_64__)
+	case SIMD_LEVEL_AVX512:
+		SHEvalIrradianceL2AVX512(pResult, resultPitch, polyCoeffs, pX, pY, pZ, numDirs);
+		break;
+	case SIMD_LEVEL_AVX2:
+		SHEvalIrradianceL2AVX2(pResult, resultPitch, polyCoeffs, pX, pY, pZ, numDirs);
+		break;
+#elif defined(_M_ARM64) || defined(__aarch64__)
+	case SIMD_LEVEL_NEON:
+		SHEvalIrradianceL2NEON(pResult, resultPitch, polyCoeffs, pX, pY, pZ, numDirs);
+		break;
+#endif
+	default:
+		SHEvalIrradianceL2Scalar(pResult, resultPitch, polyCoeffs, pX, pY, pZ, numDirs);
+	}
+}
+
+void SH::SHEvalIrradianceL2Scalar(float* pResult, size_t resultPitch, const float3* pPolyCoeffs,
+	const float* pX, const float* pY, const float* pZ, uint32_t numDirs)
+{
+	SHEvalIrradianceL2SoA<float1, 1>::Run(pResult, resultPitch, pPolyCoeffs, pX, pY, pZ, numDirs);
+}
+
+void SH::SHScale(float result[MaxCoeffCount], uint8_t order, const float input[MaxCoeffCount], float scale)
+{
+	SHDispatch<SHScaleKernel>(order, result, input, scale);
+}
+
+void SH::SHScale(float3 result[MaxCoeffCount], uint8_t order, const float input[MaxCoeffCount], const float3& scale)
+{
+	SHDispatch<SHScaleKernel>(order, result, input, scale);
+}
+
+SH::float3 SH::GetCubeTexcoord(uint8_t slice, const float3& pos)
+{
+	switch (slice)
+	{
+	case 0:
+		return float3(pos.z, pos.y, -pos.x);
+	case 1:
+		return float3(-pos.z, pos.y, pos.x);
+	case 2:
+		return float3(pos.x, pos.z, -pos.y);
+	case 3:
+		return float3(pos.x, -pos.z, pos.y);
+	case 4:
+		return float3(pos.x, pos.y, pos.z);
+	case 5:
+		return float3(-pos.x, pos.y, -pos.z);
+	default:
+		return pos;
+	}
+}
+
+SH::float3 SH::GetCubeTexcoord(uint32_t x, uint32_t y, uint8_t slice, uint32_t mapSize)
+{
+	const auto radius = static_cast<float>(mapSize) * 0.5f;
+	const float3 pos(x - radius + 0.5f, radius - 0.5f - y, radius);
+
+	return GetCubeTexcoord(slice, pos);
+}
+
+float SH::GetDiffSolid(uint32_t x, uint32_t y, uint32_t mapSize)
+{
+	// index from [0, w - 1], f(0) maps to -1 + 1/w, f(w - 1) maps to 1 - 1/w
+	// linear function x * s + b, 1st constraint means B is (-1 + 1/w), plug into
+	// second and solve for s: s = 2 * (1 - 1/w) / (w - 1).
+	const auto size = static_cast<float>(mapSize);
+	const auto b = 1.0f / size - 1.0f;
+	const auto s = mapSize > 1 ? 2.0f * (1.0f - 1.0f / size) / (size - 1.0f) : 0.0f;
+	const auto u = x * s + b;
+	const auto v = y * s + b;
+	const auto diff = 1.0f + u * u + v * v;
+
+	return 4.0f / (diff * sqrt(diff));
+}
+
+SH::SIMDLevel SH::GetSIMDLevel()
+{
+	static const auto simdLevel = detectSIMDLevel();
+
+	return simdLevel;
+}
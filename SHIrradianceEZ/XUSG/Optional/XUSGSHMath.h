@@ -0,0 +1,315 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include "Advanced/XUSGSHSharedConsts.h"
+
+namespace XUSG
+{
+	namespace SH
+	{
+		static const uint8_t MaxCoeffCount = SH_MAX_ORDER * SH_MAX_ORDER;
+
+		enum SIMDLevel : uint8_t
+		{
+			SIMD_LEVEL_SCALAR,
+			SIMD_LEVEL_NEON,
+			SIMD_LEVEL_AVX2,
+			SIMD_LEVEL_AVX512
+		};
+
+		// Band-limiting windows against ringing of truncated SH
+		enum Window : uint8_t
+		{
+			WINDOW_NONE,
+			WINDOW_HANNING,
+			WINDOW_LANCZOS
+		};
+
+		struct float3
+		{
+			float x;
+			float y;
+			float z;
+
+			float3() = default;
+			constexpr float3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+			explicit float3(const float* pArray) : x(pArray[0]), y(pArray[1]), z(pArray[2]) {}
+		};
+
+		// CPU ports of XUSG/Shaders/SHMath.hlsli, inputs (x, y, z) must be unit length
+		void sh_eval_basis_1(const float3& v, float b[4]);
+		void sh_eval_basis_2(const float3& v, float b[9]);
+		void sh_eval_basis_3(const float3& v, float b[16]);
+		void sh_eval_basis_4(const float3& v, float b[25]);
+		void sh_eval_basis_5(const float3& v, float b[36]);
+
+		void SHEvalDirection(float result[MaxCoeffCount], uint8_t order, const float3& dir);
+
+		// SoA evaluation of numDirs directions, basis k of direction i goes to pResult[resultPitch * k + i]
+		void SHEvalDirections(float* pResult, size_t resultPitch, uint8_t order,
+			const float* pX, const float* pY, const float* pZ, uint32_t numDirs);
+		void SHEvalDirections(float* pResult, size_t resultPitch, uint8_t order,
+			const float* pX, const float* pY, const float* pZ, uint32_t numDirs, SIMDLevel simdLevel);
+
+		void SHScale(float result[MaxCoeffCount], uint8_t order, const float input[MaxCoeffCount], float scale);
+		void SHScale(float3 result[MaxCoeffCount], uint8_t order, const float input[MaxCoeffCount], const float3& scale);
+
+		// Zonal coefficients A_l of the clamped cosine lobe: pi, 2pi/3, pi/4, 0, -pi/24, 0, ...
+		float SHCosineLobe(uint32_t l);
+		// Weight of band l for a window spanning the given order
+		float SHWindowWeight(uint32_t l, uint8_t order, Window window);
+
+		// Irradiance coefficients A_l * w_l * L_lm of radiance coefficients, so that the
+		// irradiance at normal n is the dot product with the basis at n. At order 3 without
+		// a window, this matches EvaluateSHIrradiance() in XUSG/Shaders/SHIrradianceTypeless.hlsli.
+		void SHConvolveIrradiance(float3 result[MaxCoeffCount], uint8_t order,
+			const float3 input[MaxCoeffCount], Window window = WINDOW_NONE);
+
+		// SoA irradiance of numDirs unit normals from the SHConvolveIrradiance() output, clamped
+		// to 0; the r, g, and b of normal i go to pResult[i], pResult[resultPitch + i], and
+		// pResult[resultPitch * 2 + i]
+		void SHEvalIrradiance(float* pResult, size_t resultPitch, uint8_t order, const float3 coeffs[MaxCoeffCount],
+			const float* pX, const float* pY, const float* pZ, uint32_t numDirs);
+		void SHEvalIrradiance(float* pResult, size_t resultPitch, uint8_t order, const float3 coeffs[MaxCoeffCount],
+			const float* pX, const float* pY, const float* pZ, uint32_t numDirs, SIMDLevel simdLevel);
+
+		// Folds the constants and sign conventions of EvaluateSHIrradiance(), or of
+		// EvaluateHairSHIrradiance() with isHair, in XUSG/Shaders/SHIrradianceTypeless.hlsli
+		// into 9 polynomial coefficients of the normal, for SHEvalIrradianceL2()
+		void SHFoldIrradianceL2(float3 result[9], const float3 input[9], bool isHair = false);
+
+		// SoA evaluation of the 9-term polynomial with the SHEvalIrradiance() output layout
+		void SHEvalIrradianceL2(float* pResult, size_t resultPitch, const float3 polyCoeffs[9],
+			const float* pX, const float* pY, const float* pZ, uint32_t numDirs);
+		void SHEvalIrradianceL2(float* pResult, size_t resultPitch, const float3 polyCoeffs[9],
+			const float* pX, const float* pY, const float* pZ, uint32_t numDirs, SIMDLevel simdLevel);
+
+		// CPU ports of XUSG/Shaders/CubeMap.hlsli and the texel weight in CSSHCubeMap.hlsl
+		float3 GetCubeTexcoord(uint8_t slice, const float3& pos);
+		float3 GetCubeTexcoord(uint32_t x, uint32_t y, uint8_t slice, uint32_t mapSize);
+		float GetDiffSolid(uint32_t x, uint32_t y, uint32_t mapSize);
+
+		// Highest instruction set supported by both the build and the running CPU
+		SIMDLevel GetSIMDLevel();
+
+		//--------------------------------------------------------------------------------------
+		// Order-specialized kernels, fully unrolled and branch-free for a given Order
+		//--------------------------------------------------------------------------------------
+		constexpr double ConstSqrt(double x)
+		{
+			auto r = x > 1.0 ? x : 1.0;
+			for (auto i = 0; i < 64; ++i) r = 0.5 * (r + x / r);
+
+			return x > 0.0 ? r : 0.0;
+		}
+
+		constexpr double Factorial(uint32_t n)
+		{
+			auto f = 1.0;
+			for (auto i = 2u; i <= n; ++i) f *= i;
+
+			return f;
+		}
+
+		// K_l^m = sqrt((2l + 1) / 4pi * (l - m)! / (l + m)!)
+		constexpr double SHNormalization(uint32_t l, uint32_t m)
+		{
+			return ConstSqrt((2.0 * l + 1.0) / (4.0 * 3.14159265358979323846) * Factorial(l - m) / Factorial(l + m));
+		}
+
+		// p_m_m of sh_eval_basis_*, including sqrt(2) for m > 0 and the Condon-Shortley phase
+		constexpr double SHSectoral(uint32_t m)
+		{
+			auto p = SHNormalization(m, m);
+			for (auto i = 1u; i <= m; ++i) p *= -(2.0 * i - 1.0);
+
+			return m > 0 ? ConstSqrt(2.0) * p : p;
+		}
+
+		// p_l_m = A * z * p_(l-1)_m - B * p_(l-2)_m
+		constexpr double SHRecurrenceA(uint32_t l, uint32_t m)
+		{
+			return (2.0 * l - 1.0) / (l - m) * SHNormalization(l, m) / SHNormalization(l - 1, m);
+		}
+
+		constexpr double SHRecurrenceB(uint32_t l, uint32_t m)
+		{
+			return l >= m + 2 ? (l + m - 1.0) / (l - m) * SHNormalization(l, m) / SHNormalization(l - 2, m) : 0.0;
+		}
+
+		template<uint32_t N>
+		struct SHUnroll
+		{
+			template<typename F>
+			static void Run(F&& f) { SHUnroll<N - 1>::Run(f); f(N - 1); }
+		};
+
+		template<>
+		struct SHUnroll<0>
+		{
+			template<typename F>
+			static void Run(F&&) {}
+		};
+
+		template<uint32_t M>
+		struct SHStore
+		{
+			template<typename T>
+			static void Store(T b[], uint32_t l, const T& p, const T& s, const T& c)
+			{
+				b[l * l + l - M] = p * s;
+				b[l * l + l + M] = p * c;
+			}
+		};
+
+		template<>
+		struct SHStore<0>
+		{
+			template<typename T>
+			static void Store(T b[], uint32_t l, const T& p, const T&, const T&) { b[l * l + l] = p; }
+		};
+
+		// Recurrence along l = L..Order-1 for a fixed m = M
+		template<uint32_t Order, uint32_t M, uint32_t L>
+		struct SHLegendre
+		{
+			static constexpr float A = static_cast<float>(SHRecurrenceA(L, M));
+			static constexpr float B = static_cast<float>(SHRecurrenceB(L, M));
+
+			template<typename T>
+			static void Eval(T b[], const T& z, const T& s, const T& c, const T& p1, const T& p2)
+			{
+				const auto p = T(A) * z * p1 - T(B) * p2;
+				SHStore<M>::Store(b, L, p, s, c);
+				SHLegendre<Order, M, L + 1>::Eval(b, z, s, c, p, p1);
+			}
+		};
+
+		template<uint32_t Order, uint32_t M>
+		struct SHLegendre<Order, M, Order>
+		{
+			template<typename T>
+			static void Eval(T[], const T&, const T&, const T&, const T&, const T&) {}
+		};
+
+		// l = M + 1 and beyond
+		template<uint32_t Order, uint32_t M, bool = (M + 1 < Order)>
+		struct SHBandTail
+		{
+			static constexpr float A = static_cast<float>(SHRecurrenceA(M + 1, M));
+
+			template<typename T>
+			static void Eval(T b[], const T& z, const T& s, const T& c, const T& pmm)
+			{
+				const auto p = T(A) * z * pmm;
+				SHStore<M>::Store(b, M + 1, p, s, c);
+				SHLegendre<Order, M, M + 2>::Eval(b, z, s, c, p, pmm);
+			}
+		};
+
+		template<uint32_t Order, uint32_t M>
+		struct SHBandTail<Order, M, false>
+		{
+			template<typename T>
+			static void Eval(T[], const T&, const T&, const T&, const T&) {}
+		};
+
+		// All l >= M for m = +-M, where (c, s) = (x + iy)^M, then m = M + 1
+		template<uint32_t Order, uint32_t M>
+		struct SHBand
+		{
+			static constexpr float PMM = static_cast<float>(SHSectoral(M));
+
+			template<typename T>
+			static void Eval(T b[], const T& x, const T& y, const T& z, const T& s, const T& c)
+			{
+				const T pmm(PMM);
+				SHStore<M>::Store(b, M, pmm, s, c);
+				SHBandTail<Order, M>::Eval(b, z, s, c, pmm);
+				SHBand<Order, M + 1>::Eval(b, x, y, z, x * s + y * c, x * c - y * s);
+			}
+		};
+
+		template<uint32_t Order>
+		struct SHBand<Order, Order>
+		{
+			template<typename T>
+			static void Eval(T[], const T&, const T&, const T&, const T&, const T&) {}
+		};
+
+		template<uint32_t Order>
+		struct SHBand<Order, 0>
+		{
+			static constexpr float PMM = static_cast<float>(SHSectoral(0));
+
+			template<typename T>
+			static void Eval(T b[], const T& x, const T& y, const T& z)
+			{
+				const T p00(PMM);
+				b[0] = p00;
+				SHBandTail<Order, 0>::Eval(b, z, z, z, p00);
+				SHBand<Order, 1>::Eval(b, x, y, z, y, x);
+			}
+		};
+
+		// T is float or a SIMD wrapper providing T(float) broadcast and + - *
+		template<uint32_t Order, typename T>
+		inline void SHEvalBasis(T b[Order * Order], const T& x, const T& y, const T& z)
+		{
+			static_assert(Order >= 2 && Order <= SH_MAX_ORDER, "SH order is out of range");
+			SHBand<Order, 0>::Eval(b, x, y, z);
+		}
+
+		template<uint32_t Order>
+		inline void SHScale(float result[Order * Order], const float input[Order * Order], float scale)
+		{
+			SHUnroll<Order * Order>::Run([&](uint32_t i) { result[i] = scale * input[i]; });
+		}
+
+		template<uint32_t Order>
+		inline void SHScale(float3 result[Order * Order], const float input[Order * Order], const float3& scale)
+		{
+			SHUnroll<Order * Order>::Run([&](uint32_t i)
+			{
+				result[i].x = scale.x * input[i];
+				result[i].y = scale.y * input[i];
+				result[i].z = scale.z * input[i];
+			});
+		}
+
+		// result += basis * color
+		template<uint32_t Order>
+		inline void SHAccumulate(float3 result[Order * Order], const float basis[Order * Order], const float3& color)
+		{
+			SHUnroll<Order * Order>::Run([&](uint32_t i)
+			{
+				result[i].x += color.x * basis[i];
+				result[i].y += color.y * basis[i];
+				result[i].z += color.z * basis[i];
+			});
+		}
+
+		// Thin runtime dispatcher to the order-specialized F<Order>::Run()
+		template<template<uint32_t> class F, typename... Args>
+		inline bool SHDispatch(uint8_t order, Args&&... args)
+		{
+			static_assert(SH_MAX_ORDER == 6, "SHDispatch() needs to cover SH_MAX_ORDER");
+
+			switch (order)
+			{
+			case 2: F<2>::Run(std::forward<Args>(args)...); return true;
+			case 3: F<3>::Run(std::forward<Args>(args)...); return true;
+			case 4: F<4>::Run(std::forward<Args>(args)...); return true;
+			case 5: F<5>::Run(std::forward<Args>(args)...); return true;
+			case 6: F<6>::Run(std::forward<Args>(args)...); return true;
+			default: return false;
+			}
+		}
+	}
+}
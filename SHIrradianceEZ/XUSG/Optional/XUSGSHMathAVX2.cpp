@@ -0,0 +1,60 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#if defined(_M_X64) || defined(__x86_64__)
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("avx2,fma")
+#endif
+
+#include <immintrin.h>
+#include "XUSGSHMathSoA.h"
+
+using namespace XUSG;
+
+namespace
+{
+	struct float8
+	{
+		__m256 v;
+
+		float8() = default;
+		float8(__m256 _v) : v(_v) {}
+		explicit float8(float s) : v(_mm256_set1_ps(s)) {}
+
+		static float8 Load(const float* p) { return _mm256_loadu_ps(p); }
+		void Store(float* p) const { _mm256_storeu_ps(p, v); }
+	};
+
+	inline float8 operator+(const float8& a, const float8& b) { return _mm256_add_ps(a.v, b.v); }
+	inline float8 operator-(const float8& a, const float8& b) { return _mm256_sub_ps(a.v, b.v); }
+	inline float8 operator*(const float8& a, const float8& b) { return _mm256_mul_ps(a.v, b.v); }
+	inline float8 Max(const float8& a, const float8& b) { return _mm256_max_ps(a.v, b.v); }
+}
+
+void SH::SHEvalDirectionsAVX2(float* pResult, size_t resultPitch, uint8_t order,
+	const float* pX, const float* pY, const float* pZ, uint32_t numDirs)
+{
+	SHEvalDirectionsSoA<float8, 8>::Run(pResult, resultPitch, order, pX, pY, pZ, numDirs);
+}
+
+void SH::SHEvalIrradianceAVX2(float* pResult, size_t resultPitch, uint8_t order, const float3* pCoeffs,
+	const float* pX, const float* pY, const float* pZ, uint32_t numDirs)
+{
+	SHEvalIrradianceSoA<float8, 8>::Run(pResult, resultPitch, order, pCoeffs, pX, pY, pZ, numDirs);
+}
+
+void SH::SHEvalIrradianceL2AVX2(float* pResult, size_t resultPitch, const float3* pPolyCoeffs,
+	const float* pX, const float* pY, const float* pZ, uint32_t numDirs)
+{
+	SHEvalIrradianceL2SoA<float8, 8>::Run(pResult, resultPitch, pPolyCoeffs, pX, pY, pZ, numDirs);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+
+#endif
@@ -0,0 +1,60 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#if defined(_M_X64) || defined(__x86_64__)
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("avx512f")
+#endif
+
+#include <immintrin.h>
+#include "XUSGSHMathSoA.h"
+
+using namespace XUSG;
+
+namespace
+{
+	struct float16
+	{
+		__m512 v;
+
+		float16() = default;
+		float16(__m512 _v) : v(_v) {}
+		explicit float16(float s) : v(_mm512_set1_ps(s)) {}
+
+		static float16 Load(const float* p) { return _mm512_loadu_ps(p); }
+		void Store(float* p) const { _mm512_storeu_ps(p, v); }
+	};
+
+	inline float16 operator+(const float16& a, const float16& b) { return _mm512_add_ps(a.v, b.v); }
+	inline float16 operator-(const float16& a, const float16& b) { return _mm512_sub_ps(a.v, b.v); }
+	inline float16 operator*(const float16& a, const float16& b) { return _mm512_mul_ps(a.v, b.v); }
+	inline float16 Max(const float16& a, const float16& b) { return _mm512_max_ps(a.v, b.v); }
+}
+
+void SH::SHEvalDirectionsAVX512(float* pResult, size_t resultPitch, uint8_t order,
+	const float* pX, const float* pY, const float* pZ, uint32_t numDirs)
+{
+	SHEvalDirectionsSoA<float16, 16>::Run(pResult, resultPitch, order, pX, pY, pZ, numDirs);
+}
+
+void SH::SHEvalIrradianceAVX512(float* pResult, size_t resultPitch, uint8_t order, const float3* pCoeffs,
+	const float* pX, const float* pY, const float* pZ, uint32_t numDirs)
+{
+	SHEvalIrradianceSoA<float16, 16>::Run(pResult, resultPitch, order, pCoeffs, pX, pY, pZ, numDirs);
+}
+
+void SH::SHEvalIrradianceL2AVX512(float* pResult, size_t resultPitch, const float3* pPolyCoeffs,
+	const float* pX, const float* pY, const float* pZ, uint32_t numDirs)
+{
+	SHEvalIrradianceL2SoA<float16, 16>::Run(pResult, resultPitch, pPolyCoeffs, pX, pY, pZ, numDirs);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+
+#endif
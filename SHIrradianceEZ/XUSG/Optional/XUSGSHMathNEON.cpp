@@ -0,0 +1,50 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#if defined(_M_ARM64) || defined(__aarch64__)
+
+#include <arm_neon.h>
+#include "XUSGSHMathSoA.h"
+
+using namespace XUSG;
+
+namespace
+{
+	struct float4
+	{
+		float32x4_t v;
+
+		float4() = default;
+		float4(float32x4_t _v) : v(_v) {}
+		explicit float4(float s) : v(vdupq_n_f32(s)) {}
+
+		static float4 Load(const float* p) { return vld1q_f32(p); }
+		void Store(float* p) const { vst1q_f32(p, v); }
+	};
+
+	inline float4 operator+(const float4& a, const float4& b) { return vaddq_f32(a.v, b.v); }
+	inline float4 operator-(const float4& a, const float4& b) { return vsubq_f32(a.v, b.v); }
+	inline float4 operator*(const float4& a, const float4& b) { return vmulq_f32(a.v, b.v); }
+	inline float4 Max(const float4& a, const float4& b) { return vmaxq_f32(a.v, b.v); }
+}
+
+void SH::SHEvalDirectionsNEON(float* pResult, size_t resultPitch, uint8_t order,
+	const float* pX, const float* pY, const float* pZ, uint32_t numDirs)
+{
+	SHEvalDirectionsSoA<float4, 4>::Run(pResult, resultPitch, order, pX, pY, pZ, numDirs);
+}
+
+void SH::SHEvalIrradianceNEON(float* pResult, size_t resultPitch, uint8_t order, const float3* pCoeffs,
+	const float* pX, const float* pY, const float* pZ, uint32_t numDirs)
+{
+	SHEvalIrradianceSoA<float4, 4>::Run(pResult, resultPitch, order, pCoeffs, pX, pY, pZ, numDirs);
+}
+
+void SH::SHEvalIrradianceL2NEON(float* pResult, size_t resultPitch, const float3* pPolyCoeffs,
+	const float* pX, const float* pY, const float* pZ, uint32_t numDirs)
+{
+	SHEvalIrradianceL2SoA<float4, 4>::Run(pResult, resultPitch, pPolyCoeffs, pX, pY, pZ, numDirs);
+}
+
+#endif
@@ -0,0 +1,208 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstring>
+#include "XUSGSHMath.h"
+
+// Internal header, shared by the per-ISA translation units of SHEvalDirections() and
+// SHEvalIrradiance(). T is a SIMD wrapper of W lanes providing T(float) broadcast,
+// T::Load(), Store(), + - * and Max().
+namespace XUSG
+{
+	namespace SH
+	{
+		template<typename T, uint32_t W>
+		struct SHEvalDirectionsSoA
+		{
+			template<uint32_t Order>
+			struct Kernel
+			{
+				static void Run(float* pResult, size_t resultPitch,
+					const float* pX, const float* pY, const float* pZ, uint32_t numDirs)
+				{
+					T b[Order * Order];
+
+					auto i = 0u;
+					for (; i + W <= numDirs; i += W)
+					{
+						SHEvalBasis<Order>(b, T::Load(&pX[i]), T::Load(&pY[i]), T::Load(&pZ[i]));
+						SHUnroll<Order * Order>::Run([&](uint32_t k) { b[k].Store(&pResult[resultPitch * k + i]); });
+					}
+
+					// Pad the remainder to a full vector
+					if (i < numDirs)
+					{
+						const auto n = numDirs - i;
+						float x[W] = {}, y[W] = {}, z[W] = {}, r[W];
+						memcpy(x, &pX[i], sizeof(float) * n);
+						memcpy(y, &pY[i], sizeof(float) * n);
+						memcpy(z, &pZ[i], sizeof(float) * n);
+
+						SHEvalBasis<Order>(b, T::Load(x), T::Load(y), T::Load(z));
+						for (auto k = 0u; k < Order * Order; ++k)
+						{
+							b[k].Store(r);
+							memcpy(&pResult[resultPitch * k + i], r, sizeof(float) * n);
+						}
+					}
+				}
+			};
+
+			static void Run(float* pResult, size_t resultPitch, uint8_t order,
+				const float* pX, const float* pY, const float* pZ, uint32_t numDirs)
+			{
+				SHDispatch<Kernel>(order, pResult, resultPitch, pX, pY, pZ, numDirs);
+			}
+		};
+
+		template<typename T, uint32_t W>
+		struct SHEvalIrradianceSoA
+		{
+			template<uint32_t Order>
+			struct Kernel
+			{
+				// Writes max(sum_k coeff_k * basis_k, 0) of W directions per channel
+				static void Eval(float* pR, float* pG, float* pB, const float3* pCoeffs,
+					const T& x, const T& y, const T& z)
+				{
+					T b[Order * Order];
+					SHEvalBasis<Order>(b, x, y, z);
+
+					auto r = T(pCoeffs[0].x) * b[0];
+					auto g = T(pCoeffs[0].y) * b[0];
+					auto bl = T(pCoeffs[0].z) * b[0];
+					SHUnroll<Order * Order - 1>::Run([&](uint32_t i)
+					{
+						const auto k = i + 1;
+						r = r + T(pCoeffs[k].x) * b[k];
+						g = g + T(pCoeffs[k].y) * b[k];
+						bl = bl + T(pCoeffs[k].z) * b[k];
+					});
+
+					const T zero(0.0f);
+					Max(r, zero).Store(pR);
+					Max(g, zero).Store(pG);
+					Max(bl, zero).Store(pB);
+				}
+
+				static void Run(float* pResult, size_t resultPitch, const float3* pCoeffs,
+					const float* pX, const float* pY, const float* pZ, uint32_t numDirs)
+				{
+					const auto pR = pResult;
+					const auto pG = &pResult[resultPitch];
+					const auto pB = &pResult[resultPitch * 2];
+
+					auto i = 0u;
+					for (; i + W <= numDirs; i += W)
+						Eval(&pR[i], &pG[i], &pB[i], pCoeffs, T::Load(&pX[i]), T::Load(&pY[i]), T::Load(&pZ[i]));
+
+					// Pad the remainder to a full vector
+					if (i < numDirs)
+					{
+						const auto n = numDirs - i;
+						float x[W] = {}, y[W] = {}, z[W] = {}, r[W], g[W], b[W];
+						memcpy(x, &pX[i], sizeof(float) * n);
+						memcpy(y, &pY[i], sizeof(float) * n);
+						memcpy(z, &pZ[i], sizeof(float) * n);
+
+						Eval(r, g, b, pCoeffs, T::Load(x), T::Load(y), T::Load(z));
+						memcpy(&pR[i], r, sizeof(float) * n);
+						memcpy(&pG[i], g, sizeof(float) * n);
+						memcpy(&pB[i], b, sizeof(float) * n);
+					}
+				}
+			};
+
+			static void Run(float* pResult, size_t resultPitch, uint8_t order, const float3* pCoeffs,
+				const float* pX, const float* pY, const float* pZ, uint32_t numDirs)
+			{
+				SHDispatch<Kernel>(order, pResult, resultPitch, pCoeffs, pX, pY, pZ, numDirs);
+			}
+		};
+
+		// The L2 polynomial of SHFoldIrradianceL2() in the monomials
+		// 1, x, y, z, xy, yz, xz, x^2 - y^2, z^2
+		template<typename T, uint32_t W>
+		struct SHEvalIrradianceL2SoA
+		{
+			static void Eval(float* pR, float* pG, float* pB, const float3* pPolyCoeffs,
+				const T& x, const T& y, const T& z)
+			{
+				const T m[] = { x, y, z, x * y, y * z, x * z, x * x - y * y, z * z };
+
+				auto r = T(pPolyCoeffs[0].x);
+				auto g = T(pPolyCoeffs[0].y);
+				auto b = T(pPolyCoeffs[0].z);
+				SHUnroll<8>::Run([&](uint32_t i)
+				{
+					r = r + T(pPolyCoeffs[i + 1].x) * m[i];
+					g = g + T(pPolyCoeffs[i + 1].y) * m[i];
+					b = b + T(pPolyCoeffs[i + 1].z) * m[i];
+				});
+
+				const T zero(0.0f);
+				Max(r, zero).Store(pR);
+				Max(g, zero).Store(pG);
+				Max(b, zero).Store(pB);
+			}
+
+			static void Run(float* pResult, size_t resultPitch, const float3* pPolyCoeffs,
+				const float* pX, const float* pY, const float* pZ, uint32_t numDirs)
+			{
+				const auto pR = pResult;
+				const auto pG = &pResult[resultPitch];
+				const auto pB = &pResult[resultPitch * 2];
+
+				auto i = 0u;
+				for (; i + W <= numDirs; i += W)
+					Eval(&pR[i], &pG[i], &pB[i], pPolyCoeffs, T::Load(&pX[i]), T::Load(&pY[i]), T::Load(&pZ[i]));
+
+				// Pad the remainder to a full vector
+				if (i < numDirs)
+				{
+					const auto n = numDirs - i;
+					float x[W] = {}, y[W] = {}, z[W] = {}, r[W], g[W], b[W];
+					memcpy(x, &pX[i], sizeof(float) * n);
+					memcpy(y, &pY[i], sizeof(float) * n);
+					memcpy(z, &pZ[i], sizeof(float) * n);
+
+					Eval(r, g, b, pPolyCoeffs, T::Load(x), T::Load(y), T::Load(z));
+					memcpy(&pR[i], r, sizeof(float) * n);
+					memcpy(&pG[i], g, sizeof(float) * n);
+					memcpy(&pB[i], b, sizeof(float) * n);
+				}
+			}
+		};
+
+		void SHEvalDirectionsScalar(float* pResult, size_t resultPitch, uint8_t order,
+			const float* pX, const float* pY, const float* pZ, uint32_t numDirs);
+		void SHEvalIrradianceScalar(float* pResult, size_t resultPitch, uint8_t order, const float3* pCoeffs,
+			const float* pX, const float* pY, const float* pZ, uint32_t numDirs);
+		void SHEvalIrradianceL2Scalar(float* pResult, size_t resultPitch, const float3* pPolyCoeffs,
+			const float* pX, const float* pY, const float* pZ, uint32_t numDirs);
+#if defined(_M_X64) || defined(__x86_64__)
+		void SHEvalDirectionsAVX2(float* pResult, size_t resultPitch, uint8_t order,
+			const float* pX, const float* pY, const float* pZ, uint32_t numDirs);
+		void SHEvalDirectionsAVX512(float* pResult, size_t resultPitch, uint8_t order,
+			const float* pX, const float* pY, const float* pZ, uint32_t numDirs);
+		void SHEvalIrradianceAVX2(float* pResult, size_t resultPitch, uint8_t order, const float3* pCoeffs,
+			const float* pX, const float* pY, const float* pZ, uint32_t numDirs);
+		void SHEvalIrradianceL2AVX2(float* pResult, size_t resultPitch, const float3* pPolyCoeffs,
+			const float* pX, const float* pY, const float* pZ, uint32_t numDirs);
+		void SHEvalIrradianceAVX512(float* pResult, size_t resultPitch, uint8_t order, const float3* pCoeffs,
+			const float* pX, const float* pY, const float* pZ, uint32_t numDirs);
+		void SHEvalIrradianceL2AVX512(float* pResult, size_t resultPitch, const float3* pPolyCoeffs,
+			const float* pX, const float* pY, const float* pZ, uint32_t numDirs);
+#elif defined(_M_ARM64) || defined(__aarch64__)
+		void SHEvalDirectionsNEON(float* pResult, size_t resultPitch, uint8_t order,
+			const float* pX, const float* pY, const float* pZ, uint32_t numDirs);
+		void SHEvalIrradianceNEON(float* pResult, size_t resultPitch, uint8_t order, const float3* pCoeffs,
+			const float* pX, const float* pY, const float* pZ, uint32_t numDirs);
+		void SHEvalIrradianceL2NEON(float* pResult, size_t resultPitch, const float3* pPolyCoeffs,
+			const float* pX, const float* pY, const float* pZ, uint32_t numDirs);
+#endif
+	}
+}
@@ -0,0 +1,305 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "XUSGSHProgressiveProjector.h"
+
+#define PI 3.1415926535897
+
+using namespace std;
+using namespace XUSG;
+using namespace SH;
+
+namespace
+{
+	// Base-2 radical inverse of the low numBits bits, i.e., Halton(i, 2) of XUSGHalton.h in
+	// fixed point; the optional modules do not link XUSGAdvanced
+	uint32_t radicalInverse2(uint32_t i, uint8_t numBits)
+	{
+		i = (i << 16) | (i >> 16);
+		i = ((i & 0x00ff00ff) << 8) | ((i & 0xff00ff00) >> 8);
+		i = ((i & 0x0f0f0f0f) << 4) | ((i & 0xf0f0f0f0) >> 4);
+		i = ((i & 0x33333333) << 2) | ((i & 0xcccccccc) >> 2);
+		i = ((i & 0x55555555) << 1) | ((i & 0xaaaaaaaa) >> 1);
+
+		return numBits ? i >> (32 - numBits) : 0;
+	}
+
+	// The even bits of a Morton index
+	uint32_t compactBits(uint32_t v)
+	{
+		v &= 0x55555555;
+		v = (v | (v >> 1)) & 0x33333333;
+		v = (v | (v >> 2)) & 0x0f0f0f0f;
+		v = (v | (v >> 4)) & 0x00ff00ff;
+		v = (v | (v >> 8)) & 0x0000ffff;
+
+		return v;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Moments of a chunk of the sequence
+//--------------------------------------------------------------------------------------
+template<uint32_t Order>
+struct ProgressiveProjector::ChunkKernel
+{
+	static void Run(const ProgressiveProjector* pProjector, Moments& moments,
+		const Projector::CubeMap& cubeMap, uint32_t sampleBegin, uint32_t sampleEnd)
+	{
+		const auto mapSize = pProjector->m_mapSize;
+		const auto texelStride = cubeMap.TexelStride ? cubeMap.TexelStride : 3u;
+		const auto rowPitch = cubeMap.RowPitch ? cubeMap.RowPitch : mapSize * texelStride;
+
+		alignas(64) float dirX[BatchSize], dirY[BatchSize], dirZ[BatchSize], diffSolids[BatchSize];
+		alignas(64) float colors[3][BatchSize];
+		alignas(64) float shBuff[Order * Order * BatchSize];
+
+		for (auto i = sampleBegin; i < sampleEnd;)
+		{
+			// Gather a batch of the texels inside the map
+			auto n = 0u;
+			for (; i < sampleEnd && n < BatchSize; ++i)
+			{
+				uint32_t x, y;
+				uint8_t slice;
+				if (!pProjector->getTexel(x, y, slice, i)) continue;
+
+				const auto dir = GetCubeTexcoord(x, y, slice, mapSize);
+				const auto l = sqrt(dir.x * dir.x + dir.y * dir.y + dir.z * dir.z);
+				dirX[n] = dir.x / l;
+				dirY[n] = dir.y / l;
+				dirZ[n] = dir.z / l;
+				diffSolids[n] = GetDiffSolid(x, y, mapSize);
+
+				const auto pTexel = &cubeMap.pFaces[slice][rowPitch * y + texelStride * x];
+				colors[0][n] = pTexel[0];
+				colors[1][n] = pTexel[1];
+				colors[2][n] = pTexel[2];
+				++n;
+			}
+
+			for (auto j = 0u; j < n; ++j)
+			{
+				const double w = diffSolids[j];
+				moments.W += w;
+				moments.W2 += w * w;
+			}
+			moments.Count += n;
+
+			SHEvalDirections(shBuff, BatchSize, Order, dirX, dirY, dirZ, n);
+			SHUnroll<Order * Order>::Run([&](uint32_t k)
+			{
+				const auto pBasis = &shBuff[BatchSize * k];
+				for (uint8_t c = 0; c < 3; ++c)
+				{
+					// Batch sums in float vectorize, the running sums stay in double
+					auto wg = 0.0f, wg2 = 0.0f, w2g = 0.0f;
+					for (auto j = 0u; j < n; ++j)
+					{
+						const auto w = diffSolids[j];
+						const auto wgj = w * colors[c][j] * pBasis[j];
+						wg += wgj;
+						wg2 += wgj * wgj;
+						w2g += w * wgj;
+					}
+					moments.WG[k][c] += wg;
+					moments.WG2[k][c] += wg2;
+					moments.W2G[k][c] += w2g;
+				}
+			});
+		}
+	}
+};
+
+//--------------------------------------------------------------------------------------
+// Progressive projector
+//--------------------------------------------------------------------------------------
+const uint32_t ProgressiveProjector::ChunkSize;
+const uint32_t ProgressiveProjector::BatchSize;
+const uint32_t ProgressiveProjector::SliceSize;
+
+ProgressiveProjector::ProgressiveProjector(uint32_t numThreads) :
+	m_threadPool(new ThreadPool(numThreads)),
+	m_moments(),
+	m_mapSize(0),
+	m_numSamples(0),
+	m_nextSample(0),
+	m_order(0),
+	m_log2Size(0)
+{
+}
+
+ProgressiveProjector::~ProgressiveProjector()
+{
+}
+
+bool ProgressiveProjector::Init(uint8_t order, uint32_t mapSize)
+{
+	// The sequence spans 6 * 4^log2Size positions in 32 bits
+	if (order < 2 || order > SH_MAX_ORDER || mapSize == 0 || mapSize > (1u << 14)) return false;
+
+	m_order = order;
+	m_mapSize = mapSize;
+	m_log2Size = 0;
+	while ((1u << m_log2Size) < mapSize) ++m_log2Size;
+	m_numSamples = 6u << (2 * m_log2Size);
+	Reset();
+
+	return true;
+}
+
+void ProgressiveProjector::Reset()
+{
+	memset(&m_moments, 0, sizeof(Moments));
+	m_nextSample = 0;
+}
+
+uint32_t ProgressiveProjector::Update(const Projector::CubeMap& cubeMap, uint32_t numSamples)
+{
+	if (m_order == 0 || cubeMap.Size != m_mapSize) return 0;
+
+	const auto sampleBegin = m_nextSample;
+	const auto sampleEnd = sampleBegin + (min)(numSamples, m_numSamples - sampleBegin);
+	const auto numChunks = (sampleEnd - sampleBegin + ChunkSize - 1) / ChunkSize;
+	if (m_chunkMoments.size() < numChunks) m_chunkMoments.resize(numChunks);
+
+	m_threadPool->ParallelFor(numChunks, [&](uint32_t i)
+	{
+		auto& moments = m_chunkMoments[i];
+		memset(&moments, 0, sizeof(Moments));
+
+		const auto chunkBegin = sampleBegin + ChunkSize * i;
+		const auto chunkEnd = (min)(chunkBegin + ChunkSize, sampleEnd);
+		SHDispatch<ChunkKernel>(m_order, this, moments, cubeMap, chunkBegin, chunkEnd);
+	});
+
+	// Merge in chunk order, so that the results do not depend on the number of threads
+	const auto numCoeffs = m_order * m_order;
+	const auto count = m_moments.Count;
+	for (auto i = 0u; i < numChunks; ++i)
+	{
+		const auto& moments = m_chunkMoments[i];
+		for (auto k = 0; k < numCoeffs; ++k)
+		{
+			for (uint8_t c = 0; c < 3; ++c)
+			{
+				m_moments.WG[k][c] += moments.WG[k][c];
+				m_moments.WG2[k][c] += moments.WG2[k][c];
+				m_moments.W2G[k][c] += moments.W2G[k][c];
+			}
+		}
+		m_moments.W += moments.W;
+		m_moments.W2 += moments.W2;
+		m_moments.Count += moments.Count;
+	}
+
+	m_nextSample = sampleEnd;
+
+	return m_moments.Count - count;
+}
+
+uint32_t ProgressiveProjector::Refine(const Projector::CubeMap& cubeMap, float maxError, uint32_t maxSamples)
+{
+	auto numProjected = 0u;
+	for (auto numSpent = 0u; numSpent < maxSamples && !IsComplete();)
+	{
+		if (GetMaxStandardError() <= maxError) break;
+
+		const auto numSamples = (min)(SliceSize, maxSamples - numSpent);
+		numProjected += Update(cubeMap, numSamples);
+		numSpent += numSamples;
+	}
+
+	return numProjected;
+}
+
+void ProgressiveProjector::GetResult(float3* pResult) const
+{
+	const auto normProj = m_moments.W > 0.0 ? 4.0 * PI / m_moments.W : 0.0;
+	const auto numCoeffs = m_order * m_order;
+	for (auto k = 0; k < numCoeffs; ++k)
+	{
+		pResult[k].x = static_cast<float>(m_moments.WG[k][0] * normProj);
+		pResult[k].y = static_cast<float>(m_moments.WG[k][1] * normProj);
+		pResult[k].z = static_cast<float>(m_moments.WG[k][2] * normProj);
+	}
+}
+
+void ProgressiveProjector::GetStandardError(float3* pResult) const
+{
+	const auto numCoeffs = m_order * m_order;
+	for (uint8_t k = 0; k < numCoeffs; ++k)
+	{
+		pResult[k].x = getStandardError(k, 0);
+		pResult[k].y = getStandardError(k, 1);
+		pResult[k].z = getStandardError(k, 2);
+	}
+}
+
+float ProgressiveProjector::GetMaxStandardError() const
+{
+	auto maxError = 0.0f;
+	const auto numCoeffs = m_order * m_order;
+	for (uint8_t k = 0; k < numCoeffs; ++k)
+		for (uint8_t c = 0; c < 3; ++c)
+			maxError = (max)(getStandardError(k, c), maxError);
+
+	return maxError;
+}
+
+uint32_t ProgressiveProjector::GetNumProjected() const
+{
+	return m_moments.Count;
+}
+
+uint32_t ProgressiveProjector::GetNumTexels() const
+{
+	return 6 * m_mapSize * m_mapSize;
+}
+
+bool ProgressiveProjector::IsComplete() const
+{
+	return m_order > 0 && m_nextSample >= m_numSamples;
+}
+
+bool ProgressiveProjector::getTexel(uint32_t& x, uint32_t& y, uint8_t& slice, uint32_t sample) const
+{
+	// Faces in turn, then the Morton index within the face in base-2 Halton order
+	slice = static_cast<uint8_t>(sample % 6);
+	const auto morton = radicalInverse2(sample / 6, 2 * m_log2Size);
+	x = compactBits(morton);
+	y = compactBits(morton >> 1);
+
+	return x < m_mapSize && y < m_mapSize;
+}
+
+float ProgressiveProjector::getStandardError(uint8_t coeff, uint8_t channel) const
+{
+	// The variance is not estimable from fewer than 2 texels
+	if (m_moments.Count < 2 || m_moments.W <= 0.0) return numeric_limits<float>::infinity();
+
+	// Saturate rather than convert doubles beyond the float range
+	return static_cast<float>((min)(sqrt(getVariance(coeff, channel)), static_cast<double>(FLT_MAX)));
+}
+
+double ProgressiveProjector::getVariance(uint8_t coeff, uint8_t channel) const
+{
+	// Linearized variance of the ratio estimator 4pi * sum(w * g) / sum(w), with the
+	// finite-population correction of sampling without replacement; needs 2 texels
+	const auto n = static_cast<double>(m_moments.Count);
+	if (m_moments.Count >= GetNumTexels()) return 0.0;
+
+	const auto r = m_moments.WG[coeff][channel] / m_moments.W;
+	const auto s2 = (max)((m_moments.WG2[coeff][channel] - 2.0 * r * m_moments.W2G[coeff][channel]
+		+ r * r * m_moments.W2) / (n - 1.0), 0.0);
+	const auto meanW = m_moments.W / n;
+	const auto fpc = 1.0 - n / GetNumTexels();
+
+	return 16.0 * PI * PI * fpc * s2 / (n * meanW * meanW);
+}
@@ -0,0 +1,83 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "XUSGSHProjector.h"
+
+namespace XUSG
+{
+	namespace SH
+	{
+		// Progressive projection of a cube map in time slices. Texels are visited in a
+		// stratified, low-discrepancy order: the faces in turn, and within a face the Morton
+		// index in base-2 Halton order, so every prefix covers the sphere evenly. The running
+		// estimate is usable after a fraction of the texels, and equals Projector::Process()
+		// up to rounding once all the texels are visited.
+		class ProgressiveProjector
+		{
+		public:
+			ProgressiveProjector(uint32_t numThreads = 0);
+			virtual ~ProgressiveProjector();
+
+			// Restarts the estimate for cube maps of the given face size
+			bool Init(uint8_t order, uint32_t mapSize);
+			void Reset();
+
+			// Projects the next numSamples positions of the sequence; returns the number of
+			// texels actually projected, which is 0 once the projection is complete
+			uint32_t Update(const Projector::CubeMap& cubeMap, uint32_t numSamples);
+			// Updates in slices until the max standard error is at most maxError, or until
+			// maxSamples positions are spent; returns the number of texels projected
+			uint32_t Refine(const Projector::CubeMap& cubeMap, float maxError, uint32_t maxSamples = UINT32_MAX);
+
+			// Writes float3[order * order], in the layout of g_roSHBuff
+			void GetResult(float3* pResult) const;
+			// Standard errors of the coefficients of GetResult(), estimated from the sample
+			// variance with the finite-population correction; conservative for stratified
+			// orders. They are infinite until 2 texels are projected.
+			void GetStandardError(float3* pResult) const;
+			float GetMaxStandardError() const;
+
+			uint32_t GetNumProjected() const;
+			uint32_t GetNumTexels() const;
+			bool IsComplete() const;
+
+		protected:
+			static const uint32_t ChunkSize = 4096;
+			static const uint32_t BatchSize = 64;
+			static const uint32_t SliceSize = 16 * ChunkSize;
+
+			// Sums over the projected texels i of w_i, w_i^2, and per coefficient and channel,
+			// w_i * g_i, (w_i * g_i)^2, and w_i^2 * g_i, where w is the differential solid angle
+			// and g the radiance times the basis
+			struct Moments
+			{
+				double WG[MaxCoeffCount][3];
+				double WG2[MaxCoeffCount][3];
+				double W2G[MaxCoeffCount][3];
+				double W;
+				double W2;
+				uint32_t Count;
+			};
+
+			template<uint32_t Order>
+			struct ChunkKernel;
+
+			bool getTexel(uint32_t& x, uint32_t& y, uint8_t& slice, uint32_t sample) const;
+			float getStandardError(uint8_t coeff, uint8_t channel) const;
+			double getVariance(uint8_t coeff, uint8_t channel) const;
+
+			std::unique_ptr<ThreadPool> m_threadPool;
+
+			std::vector<Moments> m_chunkMoments;
+			Moments		m_moments;
+			uint32_t	m_mapSize;
+			uint32_t	m_numSamples;	// Sequence positions, including those outside the map
+			uint32_t	m_nextSample;
+			uint8_t		m_order;
+			uint8_t		m_log2Size;		// Of the power-of-2 size covering the map
+		};
+	}
+}
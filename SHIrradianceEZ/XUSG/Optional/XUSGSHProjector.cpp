@@ -0,0 +1,478 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "XUSGSHProjector.h"
+
+#define PI 3.1415926535897
+
+using namespace std;
+using namespace XUSG;
+using namespace SH;
+
+//--------------------------------------------------------------------------------------
+// Accumulators of the reduction modes
+//--------------------------------------------------------------------------------------
+template<>
+struct Projector::Accumulator<REDUCTION_NAIVE>
+{
+	typedef float Type;
+
+	float Sum;
+
+	Accumulator() : Sum(0.0f) {}
+	void Add(double value) { Sum += static_cast<float>(value); }
+	double Get() const { return Sum; }
+};
+
+// Cascade summation: a binary counter of partial sums, each level holding the sum of
+// twice as many values as the level above, so that values are added in a balanced tree.
+template<>
+struct Projector::Accumulator<REDUCTION_PAIRWISE>
+{
+	typedef float Type;
+
+	float Levels[32];
+	uint32_t Count;
+	uint32_t Depth;
+
+	Accumulator() : Count(0), Depth(0) {}
+
+	void Add(double value)
+	{
+		auto sum = static_cast<float>(value);
+		for (auto k = Count++; k & 1; k >>= 1) sum = Levels[--Depth] + sum;
+		Levels[Depth++] = sum;
+	}
+
+	double Get() const
+	{
+		auto sum = 0.0f;
+		for (auto i = Depth; i > 0; --i) sum = Levels[i - 1] + sum;
+
+		return sum;
+	}
+};
+
+template<>
+struct Projector::Accumulator<REDUCTION_KAHAN>
+{
+	typedef double Type;
+
+	double Sum;
+	double Compensation;
+
+	Accumulator() : Sum(0.0), Compensation(0.0) {}
+
+	void Add(double value)
+	{
+		const auto y = value - Compensation;
+		const auto t = Sum + y;
+		Compensation = (t - Sum) - y;
+		Sum = t;
+	}
+
+	double Get() const { return Sum; }
+};
+
+//--------------------------------------------------------------------------------------
+// Order-specialized SH transform of a texel chunk for a group of probes
+//--------------------------------------------------------------------------------------
+template<ReductionMode Mode>
+struct Projector::Reduction
+{
+	typedef Accumulator<Mode> Acc;
+	typedef typename Acc::Type T;
+
+	struct Sums
+	{
+		Acc Coeffs[MaxCoeffCount][3];
+		Acc Weight;
+
+		void Add(const Partial& partial, uint32_t numCoeffs)
+		{
+			for (auto i = 0u; i < numCoeffs; ++i)
+				for (auto c = 0u; c < 3; ++c) Coeffs[i][c].Add(partial.Coeffs[i][c]);
+			Weight.Add(partial.Weight);
+		}
+
+		void Get(Partial& partial, uint32_t numCoeffs) const
+		{
+			for (auto i = 0u; i < numCoeffs; ++i)
+				for (auto c = 0u; c < 3; ++c) partial.Coeffs[i][c] = Coeffs[i][c].Get();
+			partial.Weight = Weight.Get();
+		}
+	};
+
+	template<uint32_t Order>
+	struct CubeMapKernel
+	{
+		static void Run(Partial* pPartials, const CubeMap* pCubeMaps, uint32_t numProbes,
+			uint32_t texelBegin, uint32_t texelEnd)
+		{
+			const auto mapSize = pCubeMaps[0].Size;
+			const auto sliceSize = mapSize * mapSize;
+
+			// Directions are evaluated in SoA batches, so that SHEvalDirections() can use SIMD
+			alignas(64) float dirX[BatchSize], dirY[BatchSize], dirZ[BatchSize], diffSolids[BatchSize];
+			alignas(64) float colorR[BatchSize], colorG[BatchSize], colorB[BatchSize];
+			alignas(64) float shBuff[Order * Order * BatchSize];
+
+			vector<Sums> sums(numProbes);
+			for (auto i = texelBegin; i < texelEnd; i += BatchSize)
+			{
+				const auto n = (min)(BatchSize, texelEnd - i);
+				T weight = 0;
+				for (auto j = 0u; j < n; ++j)
+				{
+					const auto xy = (i + j) % sliceSize;
+					const auto x = xy % mapSize;
+					const auto y = xy / mapSize;
+					const auto slice = static_cast<uint8_t>((i + j) / sliceSize);
+
+					const auto dir = GetCubeTexcoord(x, y, slice, mapSize);
+					const auto l = sqrt(dir.x * dir.x + dir.y * dir.y + dir.z * dir.z);
+					dirX[j] = dir.x / l;
+					dirY[j] = dir.y / l;
+					dirZ[j] = dir.z / l;
+
+					diffSolids[j] = GetDiffSolid(x, y, mapSize);
+					weight += diffSolids[j];
+				}
+
+				// The weighted basis only depends on the texel, so it is shared by all probes
+				SHEvalDirections(shBuff, BatchSize, Order, dirX, dirY, dirZ, n);
+				SHUnroll<Order * Order>::Run([&](uint32_t k)
+				{
+					const auto pBasis = &shBuff[BatchSize * k];
+					for (auto j = 0u; j < n; ++j) pBasis[j] *= diffSolids[j];
+				});
+
+				for (auto p = 0u; p < numProbes; ++p)
+				{
+					const auto& cubeMap = pCubeMaps[p];
+					const auto texelStride = cubeMap.TexelStride ? cubeMap.TexelStride : 3u;
+					const auto rowPitch = cubeMap.RowPitch ? cubeMap.RowPitch : mapSize * texelStride;
+
+					for (auto j = 0u; j < n; ++j)
+					{
+						const auto xy = (i + j) % sliceSize;
+						const auto x = xy % mapSize;
+						const auto y = xy / mapSize;
+						const auto slice = (i + j) / sliceSize;
+
+						const auto pTexel = &cubeMap.pFaces[slice][rowPitch * y + texelStride * x];
+						colorR[j] = pTexel[0];
+						colorG[j] = pTexel[1];
+						colorB[j] = pTexel[2];
+					}
+
+					auto& sum = sums[p];
+					SHUnroll<Order * Order>::Run([&](uint32_t k)
+					{
+						const auto pBasis = &shBuff[BatchSize * k];
+						T r = 0, g = 0, b = 0;
+						for (auto j = 0u; j < n; ++j)
+						{
+							r += static_cast<T>(colorR[j]) * pBasis[j];
+							g += static_cast<T>(colorG[j]) * pBasis[j];
+							b += static_cast<T>(colorB[j]) * pBasis[j];
+						}
+						sum.Coeffs[k][0].Add(r);
+						sum.Coeffs[k][1].Add(g);
+						sum.Coeffs[k][2].Add(b);
+					});
+					sum.Weight.Add(weight);
+				}
+			}
+
+			for (auto p = 0u; p < numProbes; ++p) sums[p].Get(pPartials[p], Order * Order);
+		}
+	};
+
+	template<uint32_t Order>
+	struct TableKernel
+	{
+		static void Run(Partial* pPartials, const CubeMap* pCubeMaps, uint32_t numProbes,
+			const BasisTable& table, uint32_t texelBegin, uint32_t texelEnd)
+		{
+			const auto mapSize = pCubeMaps[0].Size;
+			const auto sliceSize = mapSize * mapSize;
+
+			// Batch-major, so that the table rows of a batch stay in cache for the whole probe group
+			vector<Sums> sums(numProbes);
+			for (auto i = texelBegin; i < texelEnd; i += BatchSize)
+			{
+				const auto n = (min)(BatchSize, texelEnd - i);
+				for (auto p = 0u; p < numProbes; ++p)
+				{
+					const auto& cubeMap = pCubeMaps[p];
+					const auto texelStride = cubeMap.TexelStride ? cubeMap.TexelStride : 3u;
+					const auto rowPitch = cubeMap.RowPitch ? cubeMap.RowPitch : mapSize * texelStride;
+
+					T coeffs[Order * Order][3] = {};
+					for (auto j = 0u; j < n; ++j)
+					{
+						const auto xy = (i + j) % sliceSize;
+						const auto x = xy % mapSize;
+						const auto y = xy / mapSize;
+						const auto slice = (i + j) / sliceSize;
+
+						const auto pTexel = &cubeMap.pFaces[slice][rowPitch * y + texelStride * x];
+						const auto pRow = table.GetRow(i + j);
+						SHUnroll<Order * Order>::Run([&](uint32_t k)
+						{
+							coeffs[k][0] += static_cast<T>(pTexel[0]) * pRow[k];
+							coeffs[k][1] += static_cast<T>(pTexel[1]) * pRow[k];
+							coeffs[k][2] += static_cast<T>(pTexel[2]) * pRow[k];
+						});
+					}
+
+					auto& sum = sums[p];
+					SHUnroll<Order * Order>::Run([&](uint32_t k)
+					{
+						for (auto c = 0u; c < 3; ++c) sum.Coeffs[k][c].Add(coeffs[k][c]);
+					});
+				}
+			}
+
+			for (auto p = 0u; p < numProbes; ++p) sums[p].Get(pPartials[p], Order * Order);
+		}
+	};
+
+	// Sums the chunks lane, lane + numLanes, lane + 2 * numLanes, ... in order
+	static void shLane(Partial* pPartials, const CubeMap* pCubeMaps, uint32_t numProbes, uint8_t order,
+		const BasisTable* pTable, uint32_t lane, uint32_t numLanes, uint32_t numTexels)
+	{
+		const auto numCoeffs = order * order;
+		Partial chunkPartials[ProbesPerTask];
+		vector<Sums> sums(numProbes);
+		for (auto texelBegin = ChunkSize * lane; texelBegin < numTexels; texelBegin += ChunkSize * numLanes)
+		{
+			const auto texelEnd = (min)(texelBegin + ChunkSize, numTexels);
+			if (pTable) SHDispatch<TableKernel>(order, chunkPartials, pCubeMaps, numProbes, *pTable, texelBegin, texelEnd);
+			else SHDispatch<CubeMapKernel>(order, chunkPartials, pCubeMaps, numProbes, texelBegin, texelEnd);
+
+			for (auto p = 0u; p < numProbes; ++p) sums[p].Add(chunkPartials[p], numCoeffs);
+		}
+
+		for (auto p = 0u; p < numProbes; ++p) sums[p].Get(pPartials[p], numCoeffs);
+	}
+
+	// A basis table is already weighted and normalized
+	static void shNormalize(float3* pResult, const Sums& sums, uint8_t order, bool isNormalized)
+	{
+		Partial sum;
+		const auto numCoeffs = order * order;
+		sums.Get(sum, numCoeffs);
+
+		const auto wt = sum.Weight;
+		const auto normProj = isNormalized ? 1.0 : (wt > 0.0 ? 4.0 * PI / wt : 0.0);
+		for (auto i = 0; i < numCoeffs; ++i)
+		{
+			pResult[i].x = static_cast<float>(sum.Coeffs[i][0] * normProj);
+			pResult[i].y = static_cast<float>(sum.Coeffs[i][1] * normProj);
+			pResult[i].z = static_cast<float>(sum.Coeffs[i][2] * normProj);
+		}
+	}
+};
+
+//--------------------------------------------------------------------------------------
+// Projector
+//--------------------------------------------------------------------------------------
+const uint32_t Projector::BatchSize;
+const uint32_t Projector::ChunkSize;
+const uint32_t Projector::ProbesPerTask;
+const uint32_t Projector::NumLanes;
+
+Projector::Projector(uint32_t numThreads, ReductionMode reductionMode) :
+	m_threadPool(new ThreadPool(numThreads)),
+	m_reductionMode(reductionMode)
+{
+}
+
+Projector::~Projector()
+{
+}
+
+bool Projector::Process(float3* pResult, const CubeMap& cubeMap, uint8_t order) const
+{
+	return process(pResult, &cubeMap, 1, order, nullptr);
+}
+
+bool Projector::Process(float3* pResult, const CubeMap& cubeMap, const BasisTable& table) const
+{
+	return process(pResult, &cubeMap, 1, table.GetOrder(), &table);
+}
+
+bool Projector::Process(float3* pResults, const CubeMap* pCubeMaps, uint32_t numProbes, uint8_t order) const
+{
+	return process(pResults, pCubeMaps, numProbes, order, nullptr);
+}
+
+bool Projector::Process(float3* pResults, const CubeMap* pCubeMaps, uint32_t numProbes, const BasisTable& table) const
+{
+	return process(pResults, pCubeMaps, numProbes, table.GetOrder(), &table);
+}
+
+void Projector::SetReductionMode(ReductionMode reductionMode)
+{
+	m_reductionMode = reductionMode;
+}
+
+ReductionMode Projector::GetReductionMode() const
+{
+	return m_reductionMode;
+}
+
+uint32_t Projector::GetNumThreads() const
+{
+	return m_threadPool->GetNumThreads();
+}
+
+size_t Projector::GetScratchSize(uint32_t mapSize, uint32_t numProbes) const
+{
+	switch (m_reductionMode)
+	{
+	case REDUCTION_PAIRWISE:
+		return getScratchSize<REDUCTION_PAIRWISE>(mapSize, numProbes);
+	case REDUCTION_KAHAN:
+		return getScratchSize<REDUCTION_KAHAN>(mapSize, numProbes);
+	default:
+		return getScratchSize<REDUCTION_NAIVE>(mapSize, numProbes);
+	}
+}
+
+size_t Projector::GetGPUScratchSize(uint32_t mapSize, uint32_t numProbes)
+{
+	// Mirrors the buffer sizing in LightProbe::Init()
+	const size_t numTexels = mapSize * mapSize * 6;
+	const auto numGroups = (numTexels + SH_GROUP_SIZE - 1) / SH_GROUP_SIZE;
+	const auto numSumGroups = (numGroups + SH_GROUP_SIZE - 1) / SH_GROUP_SIZE;
+	const auto maxElements = SH_MAX_ORDER * SH_MAX_ORDER * numGroups;
+	const auto maxSumElements = SH_MAX_ORDER * SH_MAX_ORDER * numSumGroups;
+
+	return (sizeof(float[3]) * (maxElements + maxSumElements) + sizeof(float) * (numGroups + numSumGroups)) * numProbes;
+}
+
+bool Projector::process(float3* pResults, const CubeMap* pCubeMaps, uint32_t numProbes,
+	uint8_t order, const BasisTable* pTable) const
+{
+	if (!pResults || !pCubeMaps || numProbes == 0) return false;
+	if (order < 2 || order > SH_MAX_ORDER) return false;
+
+	const auto mapSize = pCubeMaps[0].Size;
+	if (mapSize == 0) return false;
+	if (pTable && (!pTable->GetData() || pTable->GetMapSize() != mapSize)) return false;
+	for (auto i = 0u; i < numProbes; ++i)
+	{
+		if (pCubeMaps[i].Size != mapSize) return false;
+		for (const auto& pFace : pCubeMaps[i].pFaces) if (!pFace) return false;
+	}
+
+	switch (m_reductionMode)
+	{
+	case REDUCTION_PAIRWISE:
+		reduce<REDUCTION_PAIRWISE>(pResults, pCubeMaps, numProbes, order, pTable);
+		break;
+	case REDUCTION_KAHAN:
+		reduce<REDUCTION_KAHAN>(pResults, pCubeMaps, numProbes, order, pTable);
+		break;
+	default:
+		reduce<REDUCTION_NAIVE>(pResults, pCubeMaps, numProbes, order, pTable);
+	}
+
+	return true;
+}
+
+template<ReductionMode Mode>
+size_t Projector::getScratchSize(uint32_t mapSize, uint32_t numProbes) const
+{
+	typedef Reduction<Mode> R;
+
+	const auto numTexels = mapSize * mapSize * 6;
+	const auto numChunks = (numTexels + ChunkSize - 1) / ChunkSize;
+	const auto numLanes = (min)(NumLanes, numChunks);
+	const auto numGroups = (numProbes + ProbesPerTask - 1) / ProbesPerTask;
+	const auto numThreads = m_threadPool->GetNumThreads();
+	const auto groupSize = (min)(ProbesPerTask, numProbes);
+
+	// Per task: lane and chunk partials, lane, chunk and total sums, and the SoA batch
+	const size_t taskSize = sizeof(Partial) * ProbesPerTask * 2 + sizeof(typename R::Sums) * groupSize * 3 +
+		sizeof(float) * BatchSize * (MaxCoeffCount + 7);
+
+	if (numGroups >= numThreads) return taskSize * numThreads;
+
+	const auto numTasks = numGroups * numLanes;
+
+	return taskSize * (min)(numThreads, numTasks) + sizeof(Partial) * numProbes * numLanes;
+}
+
+template<ReductionMode Mode>
+void Projector::reduce(float3* pResults, const CubeMap* pCubeMaps, uint32_t numProbes,
+	uint8_t order, const BasisTable* pTable) const
+{
+	typedef Reduction<Mode> R;
+
+	// Probes are grouped to share the basis. The texel chunks are always distributed over
+	// the same lanes, and the lane sums of a probe are always merged in the lane order.
+	const auto mapSize = pCubeMaps[0].Size;
+	const auto numTexels = mapSize * mapSize * 6;
+	const auto numChunks = (numTexels + ChunkSize - 1) / ChunkSize;
+	const auto numLanes = (min)(NumLanes, numChunks);
+	const auto numGroups = (numProbes + ProbesPerTask - 1) / ProbesPerTask;
+	const auto numCoeffs = order * order;
+
+	if (numGroups >= m_threadPool->GetNumThreads())
+	{
+		// Enough groups to occupy the pool; each task walks over the lanes of its own group.
+		m_threadPool->ParallelFor(numGroups, [&](uint32_t group)
+		{
+			const auto probeBegin = ProbesPerTask * group;
+			const auto groupSize = (min)(ProbesPerTask, numProbes - probeBegin);
+
+			Partial partials[ProbesPerTask];
+			vector<typename R::Sums> sums(groupSize);
+			for (auto lane = 0u; lane < numLanes; ++lane)
+			{
+				R::shLane(partials, &pCubeMaps[probeBegin], groupSize, order, pTable, lane, numLanes, numTexels);
+				for (auto p = 0u; p < groupSize; ++p) sums[p].Add(partials[p], numCoeffs);
+			}
+
+			for (auto p = 0u; p < groupSize; ++p)
+				R::shNormalize(&pResults[numCoeffs * (probeBegin + p)], sums[p], order, pTable != nullptr);
+		});
+	}
+	else
+	{
+		// Few probes; the lanes run in parallel, each into its own accumulators, before a single merge.
+		vector<Partial> partials(static_cast<size_t>(numProbes) * numLanes);
+		m_threadPool->ParallelFor(numGroups * numLanes, [&](uint32_t i)
+		{
+			const auto group = i / numLanes;
+			const auto lane = i % numLanes;
+			const auto probeBegin = ProbesPerTask * group;
+			const auto groupSize = (min)(ProbesPerTask, numProbes - probeBegin);
+
+			const auto pPartials = &partials[numLanes * probeBegin + groupSize * lane];
+			R::shLane(pPartials, &pCubeMaps[probeBegin], groupSize, order, pTable, lane, numLanes, numTexels);
+		});
+
+		m_threadPool->ParallelFor(numGroups, [&](uint32_t group)
+		{
+			const auto probeBegin = ProbesPerTask * group;
+			const auto groupSize = (min)(ProbesPerTask, numProbes - probeBegin);
+			const auto pPartials = &partials[numLanes * probeBegin];
+
+			vector<typename R::Sums> sums(groupSize);
+			for (auto lane = 0u; lane < numLanes; ++lane)
+				for (auto p = 0u; p < groupSize; ++p) sums[p].Add(pPartials[groupSize * lane + p], numCoeffs);
+
+			for (auto p = 0u; p < groupSize; ++p)
+				R::shNormalize(&pResults[numCoeffs * (probeBegin + p)], sums[p], order, pTable != nullptr);
+		});
+	}
+}
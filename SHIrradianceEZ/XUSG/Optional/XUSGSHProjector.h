@@ -0,0 +1,94 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <memory>
+#include "XUSGSHBasisTable.h"
+#include "XUSGThreadPool.h"
+
+namespace XUSG
+{
+	namespace SH
+	{
+		// Accumulation of the texel contributions. Every mode sums fixed-size texel chunks into
+		// a fixed number of lanes, then merges the lanes in order, so the results do not
+		// depend on the number of threads.
+		enum ReductionMode : uint8_t
+		{
+			REDUCTION_NAIVE,	// Sequential float sums
+			REDUCTION_PAIRWISE,	// Cascaded pairwise float sums
+			REDUCTION_KAHAN		// Kahan-compensated double sums
+		};
+
+		// CPU counterpart of CSSHCubeMap.hlsl + CSSHSum.hlsl + CSSHNormalize.hlsl,
+		// no graphics device is required.
+		class Projector
+		{
+		public:
+			struct CubeMap
+			{
+				const float* pFaces[6];	// Face texels in the slice order of CubeMap.hlsli
+				uint32_t Size;			// Face width and height in texels
+				uint32_t RowPitch;		// In floats, 0 for tightly packed rows
+				uint8_t TexelStride;	// In floats, 3 for RGB and 4 for RGBA
+			};
+
+			Projector(uint32_t numThreads = 0, ReductionMode reductionMode = REDUCTION_NAIVE);
+			virtual ~Projector();
+
+			// Writes float3[order * order], in the layout of g_roSHBuff
+			bool Process(float3* pResult, const CubeMap& cubeMap, uint8_t order) const;
+			// Projects through a precomputed table, the order and size are taken from the table
+			bool Process(float3* pResult, const CubeMap& cubeMap, const BasisTable& table) const;
+
+			// Batched versions for probes of the same face size; the basis of each texel is
+			// evaluated once and shared by all probes. Writes float3[numProbes][order * order].
+			bool Process(float3* pResults, const CubeMap* pCubeMaps, uint32_t numProbes, uint8_t order) const;
+			bool Process(float3* pResults, const CubeMap* pCubeMaps, uint32_t numProbes, const BasisTable& table) const;
+
+			void SetReductionMode(ReductionMode reductionMode);
+
+			ReductionMode GetReductionMode() const;
+			uint32_t GetNumThreads() const;
+
+			// Peak intermediate memory in bytes, bounded by the lane and thread counts rather
+			// than by the texel count
+			size_t GetScratchSize(uint32_t mapSize, uint32_t numProbes = 1) const;
+			// Memory of the m_coeffSH and m_weightSH buffers in LightProbe for the same work
+			static size_t GetGPUScratchSize(uint32_t mapSize, uint32_t numProbes = 1);
+
+		protected:
+			static const uint32_t BatchSize = 64;
+			static const uint32_t ChunkSize = 64 * BatchSize;
+			static const uint32_t ProbesPerTask = 16;
+			static const uint32_t NumLanes = 64;
+
+			// Chunk sums are kept in double, so that the Kahan mode does not lose them
+			struct Partial
+			{
+				double Coeffs[MaxCoeffCount][3];
+				double Weight;
+			};
+
+			template<ReductionMode Mode>
+			struct Accumulator;
+			template<ReductionMode Mode>
+			struct Reduction;
+
+			bool process(float3* pResults, const CubeMap* pCubeMaps, uint32_t numProbes,
+				uint8_t order, const BasisTable* pTable) const;
+
+			template<ReductionMode Mode>
+			size_t getScratchSize(uint32_t mapSize, uint32_t numProbes) const;
+			template<ReductionMode Mode>
+			void reduce(float3* pResults, const CubeMap* pCubeMaps, uint32_t numProbes,
+				uint8_t order, const BasisTable* pTable) const;
+
+			std::unique_ptr<ThreadPool> m_threadPool;
+
+			ReductionMode m_reductionMode;
+		};
+	}
+}
@@ -0,0 +1,312 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "XUSGSHRotation.h"
+
+using namespace std;
+using namespace XUSG;
+
+namespace
+{
+	inline float scale(float a, float s)
+	{
+		return a * s;
+	}
+
+	inline SH::float3 scale(const SH::float3& a, float s)
+	{
+		return SH::float3(a.x * s, a.y * s, a.z * s);
+	}
+
+	inline void madd(float& result, float a, float b)
+	{
+		result += a * b;
+	}
+
+	inline void madd(SH::float3& result, float a, const SH::float3& b)
+	{
+		result.x += a * b.x;
+		result.y += a * b.y;
+		result.z += a * b.z;
+	}
+
+	inline uint32_t bandOffset(uint32_t l)
+	{
+		return l * (4 * l * l - 1) / 3;
+	}
+
+	// Band matrices of the real SH without the Condon-Shortley phase, by the recurrence of
+	// Ivanic and Ruedenberg, "Rotation Matrices for Real Spherical Harmonics. Direct
+	// Determination by Recursion", with the corrections of 1998
+	class BandRecurrence
+	{
+	public:
+		BandRecurrence(const double rotation[9], uint32_t order) :
+			m_bands(order)
+		{
+			// Band 1 is (y, z, x) for m = -1, 0, 1
+			static const uint8_t axes[] = { 1, 2, 0 };
+			m_bands[0].assign(1, 1.0);
+			if (order > 1)
+			{
+				m_bands[1].resize(9);
+				for (uint8_t m = 0; m < 3; ++m)
+					for (uint8_t n = 0; n < 3; ++n)
+						m_bands[1][3 * m + n] = rotation[3 * axes[m] + axes[n]];
+			}
+
+			for (auto l = 2u; l < order; ++l)
+			{
+				const auto li = static_cast<int32_t>(l);
+				m_bands[l].resize((2 * l + 1) * (2 * l + 1));
+				for (auto m = -li; m <= li; ++m)
+					for (auto n = -li; n <= li; ++n)
+						m_bands[l][(m + li) * (2 * li + 1) + n + li] = entry(li, m, n);
+			}
+		}
+
+		double Get(int32_t l, int32_t m, int32_t n) const
+		{
+			return m_bands[l][(m + l) * (2 * l + 1) + n + l];
+		}
+
+	protected:
+		double r1(int32_t m, int32_t n) const { return Get(1, m, n); }
+
+		double p(int32_t i, int32_t l, int32_t a, int32_t b) const
+		{
+			if (b == l) return r1(i, 1) * Get(l - 1, a, l - 1) - r1(i, -1) * Get(l - 1, a, -l + 1);
+			if (b == -l) return r1(i, 1) * Get(l - 1, a, -l + 1) + r1(i, -1) * Get(l - 1, a, l - 1);
+
+			return r1(i, 0) * Get(l - 1, a, b);
+		}
+
+		double entry(int32_t l, int32_t m, int32_t n) const
+		{
+			const auto am = abs(m);
+			const auto d = m == 0 ? 1.0 : 0.0;
+			const auto denom = abs(n) == l ? 2.0 * l * (2.0 * l - 1.0) : static_cast<double>((l + n) * (l - n));
+
+			const auto u = sqrt((l + m) * (l - m) / denom);
+			const auto v = 0.5 * sqrt((1.0 + d) * (l + am - 1.0) * (l + am) / denom) * (1.0 - 2.0 * d);
+			const auto w = -0.5 * sqrt((l - am - 1.0) * (l - am) / denom) * (1.0 - d);
+
+			auto result = u != 0.0 ? u * p(0, l, m, n) : 0.0;
+			if (v != 0.0)
+			{
+				double vv;
+				if (m == 0) vv = p(1, l, 1, n) + p(-1, l, -1, n);
+				else if (m > 0)
+				{
+					const auto d1 = m == 1 ? 1.0 : 0.0;
+					vv = p(1, l, m - 1, n) * sqrt(1.0 + d1) - p(-1, l, -m + 1, n) * (1.0 - d1);
+				}
+				else
+				{
+					const auto d1 = m == -1 ? 1.0 : 0.0;
+					vv = p(1, l, m + 1, n) * (1.0 - d1) + p(-1, l, -m - 1, n) * sqrt(1.0 + d1);
+				}
+				result += v * vv;
+			}
+
+			if (w != 0.0)
+			{
+				const auto ww = m > 0 ? p(1, l, m + 1, n) + p(-1, l, -m - 1, n) :
+					p(1, l, m - 1, n) - p(-1, l, -m + 1, n);
+				result += w * ww;
+			}
+
+			return result;
+		}
+
+		vector<vector<double>> m_bands;
+	};
+
+	template<uint32_t Order>
+	struct SHRotateKernel
+	{
+		template<typename T>
+		static void Run(T* pResult, const T* pInput, uint32_t numSets, const float* pMatrices)
+		{
+			static const uint32_t NumCoeffs = Order * Order;
+
+			for (auto s = 0u; s < numSets; ++s)
+			{
+				T input[NumCoeffs];
+				copy(&pInput[NumCoeffs * s], &pInput[NumCoeffs * (s + 1)], input);
+
+				const auto result = &pResult[NumCoeffs * s];
+				result[0] = input[0];
+				SH::SHUnroll<Order - 1>::Run([&](uint32_t i)
+				{
+					const auto l = i + 1;
+					const auto n = 2 * l + 1;
+					const auto pMatrix = &pMatrices[bandOffset(l)];
+					const auto pBand = &input[l * l];
+					for (auto m = 0u; m < n; ++m)
+					{
+						const auto pRow = &pMatrix[n * m];
+						auto& r = result[l * l + m];
+						r = scale(pBand[0], pRow[0]);
+						for (auto k = 1u; k < n; ++k) madd(r, pRow[k], pBand[k]);
+					}
+				});
+			}
+		}
+	};
+
+	template<uint32_t Order>
+	struct SHRotateZKernel
+	{
+		template<typename T>
+		static void Run(T* pResult, const T* pInput, uint32_t numSets, const float* pCos, const float* pSin)
+		{
+			static const uint32_t NumCoeffs = Order * Order;
+
+			for (auto s = 0u; s < numSets; ++s)
+			{
+				const auto input = &pInput[NumCoeffs * s];
+				const auto result = &pResult[NumCoeffs * s];
+				result[0] = input[0];
+				SH::SHUnroll<Order - 1>::Run([&](uint32_t i)
+				{
+					const auto l = i + 1;
+					const auto c = l * l + l;
+					result[c] = input[c];
+					for (auto m = 1u; m <= l; ++m)
+					{
+						// Basis l * l + l + m goes with cos(m * phi), and l * l + l - m with sin(m * phi)
+						const auto a = input[c + m];
+						const auto b = input[c - m];
+						result[c + m] = scale(a, pCos[m]);
+						madd(result[c + m], -pSin[m], b);
+						result[c - m] = scale(a, pSin[m]);
+						madd(result[c - m], pCos[m], b);
+					}
+				});
+			}
+		}
+	};
+}
+
+const uint32_t SHRotation::MatrixSize;
+
+SHRotation::SHRotation(uint8_t order) :
+	m_matrices(),
+	m_cos(),
+	m_sin(),
+	m_order(static_cast<uint8_t>((min)((max)(order, static_cast<uint8_t>(2)), static_cast<uint8_t>(SH_MAX_ORDER)))),
+	m_isRotationZ(true)
+{
+	SetRotationZ(0.0f);
+}
+
+SHRotation::~SHRotation()
+{
+}
+
+void SHRotation::SetMatrix(const float rotation[9])
+{
+	double r[9];
+	for (uint8_t i = 0; i < 9; ++i) r[i] = rotation[i];
+
+	// Rotations keeping the Z axis take the fast path
+	const auto tilt = (max)((max)(fabs(r[2]), fabs(r[5])), (max)(fabs(r[6]), fabs(r[7])));
+	if (tilt < 1.0e-6 && r[8] > 0.0)
+	{
+		SetRotationZ(static_cast<float>(atan2(r[3], r[0])));
+		return;
+	}
+
+	// Our basis carries the Condon-Shortley phase (-1)^|m| on both cos and sin terms
+	const BandRecurrence recurrence(r, m_order);
+	for (auto l = 0; l < m_order; ++l)
+	{
+		const auto pMatrix = &m_matrices[bandOffset(l)];
+		for (auto m = -l; m <= l; ++m)
+			for (auto n = -l; n <= l; ++n)
+			{
+				const auto sign = ((abs(m) + abs(n)) & 1) ? -1.0 : 1.0;
+				pMatrix[(m + l) * (2 * l + 1) + n + l] = static_cast<float>(sign * recurrence.Get(l, m, n));
+			}
+	}
+
+	m_isRotationZ = false;
+}
+
+void SHRotation::SetRotationZ(float angle)
+{
+	// cos(m * angle) and sin(m * angle) by the angle-addition recurrence
+	const auto c = cos(static_cast<double>(angle));
+	const auto s = sin(static_cast<double>(angle));
+	auto cm = 1.0, sm = 0.0;
+	for (uint8_t m = 0; m < m_order; ++m)
+	{
+		m_cos[m] = static_cast<float>(cm);
+		m_sin[m] = static_cast<float>(sm);
+		const auto t = cm * c - sm * s;
+		sm = sm * c + cm * s;
+		cm = t;
+	}
+
+	// Keep the band matrices valid for GetBandMatrix()
+	fill_n(m_matrices, MatrixSize, 0.0f);
+	for (auto l = 0; l < m_order; ++l)
+	{
+		const auto n = 2 * l + 1;
+		const auto pMatrix = &m_matrices[bandOffset(l)];
+		pMatrix[l * n + l] = 1.0f;
+		for (auto m = 1; m <= l; ++m)
+		{
+			pMatrix[(l + m) * n + l + m] = m_cos[m];
+			pMatrix[(l + m) * n + l - m] = -m_sin[m];
+			pMatrix[(l - m) * n + l + m] = m_sin[m];
+			pMatrix[(l - m) * n + l - m] = m_cos[m];
+		}
+	}
+
+	m_isRotationZ = true;
+}
+
+void SHRotation::Rotate(float result[], const float input[]) const
+{
+	if (m_isRotationZ) SH::SHDispatch<SHRotateZKernel>(m_order, result, input, 1u, m_cos, m_sin);
+	else SH::SHDispatch<SHRotateKernel>(m_order, result, input, 1u, m_matrices);
+}
+
+void SHRotation::Rotate(SH::float3 result[], const SH::float3 input[]) const
+{
+	Rotate(result, input, 1);
+}
+
+void SHRotation::Rotate(SH::float3* pResult, const SH::float3* pInput, uint32_t numSets) const
+{
+	if (m_isRotationZ) SH::SHDispatch<SHRotateZKernel>(m_order, pResult, pInput, numSets, m_cos, m_sin);
+	else SH::SHDispatch<SHRotateKernel>(m_order, pResult, pInput, numSets, m_matrices);
+}
+
+uint8_t SHRotation::GetOrder() const
+{
+	return m_order;
+}
+
+bool SHRotation::IsRotationZ() const
+{
+	return m_isRotationZ;
+}
+
+const float* SHRotation::GetBandMatrix(uint8_t l) const
+{
+	return l < m_order ? &m_matrices[bandOffset(l)] : nullptr;
+}
+
+void SHRotation::RotateZ(SH::float3 result[], uint8_t order, const SH::float3 input[], float angle)
+{
+	SHRotation rotation(order);
+	rotation.SetRotationZ(angle);
+	rotation.Rotate(result, input);
+}
@@ -0,0 +1,49 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "XUSGSHMath.h"
+
+namespace XUSG
+{
+	// Rotation of SH coefficients in the basis of SH::SHEvalDirection(), as one matrix per
+	// band, so that the rotated function at R * d equals the input function at d. Rotating
+	// a probe this way costs O(order^3) instead of reprojecting its environment.
+	class SHRotation
+	{
+	public:
+		SHRotation(uint8_t order = SH_MAX_ORDER);
+		virtual ~SHRotation();
+
+		// Row-major R rotating column vectors as R * d; note that XMFLOAT3X3 stores of
+		// DirectXMath matrices rotate row vectors, i.e., they are R transposed.
+		void SetMatrix(const float rotation[9]);
+		// Rotation around the Z axis, which only mixes the +-m pairs of each band
+		void SetRotationZ(float angle);
+
+		// The results may alias the inputs
+		void Rotate(float result[], const float input[]) const;
+		void Rotate(SH::float3 result[], const SH::float3 input[]) const;
+		// numSets consecutive coefficient sets of order * order coefficients each
+		void Rotate(SH::float3* pResult, const SH::float3* pInput, uint32_t numSets) const;
+
+		uint8_t GetOrder() const;
+		bool IsRotationZ() const;
+		// (2l + 1) x (2l + 1) row-major matrix of band l, for m, n = -l..l
+		const float* GetBandMatrix(uint8_t l) const;
+
+		static void RotateZ(SH::float3 result[], uint8_t order, const SH::float3 input[], float angle);
+
+	protected:
+		// Sum of (2l + 1)^2 over l < SH_MAX_ORDER
+		static const uint32_t MatrixSize = SH_MAX_ORDER * (4 * SH_MAX_ORDER * SH_MAX_ORDER - 1) / 3;
+
+		float		m_matrices[MatrixSize];
+		float		m_cos[SH_MAX_ORDER];	// cos(m * angle) of the Z rotation
+		float		m_sin[SH_MAX_ORDER];	// sin(m * angle) of the Z rotation
+		uint8_t		m_order;
+		bool		m_isRotationZ;
+	};
+}
@@ -0,0 +1,96 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "XUSGThreadPool.h"
+
+using namespace std;
+using namespace XUSG;
+
+ThreadPool::ThreadPool(uint32_t numThreads) :
+	m_pFunc(nullptr),
+	m_numTasks(0),
+	m_nextTask(0),
+	m_numActive(0),
+	m_generation(0),
+	m_quit(false)
+{
+	if (numThreads == 0) numThreads = thread::hardware_concurrency();
+	if (numThreads == 0) numThreads = 1;
+
+	m_workers.reserve(numThreads - 1);
+	for (auto i = 1u; i < numThreads; ++i)
+		m_workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_workCV.notify_all();
+
+	for (auto& worker : m_workers) worker.join();
+}
+
+void ThreadPool::ParallelFor(uint32_t numTasks, const TaskFunc& func)
+{
+	if (numTasks == 0) return;
+
+	// Not worth waking the workers up
+	if (numTasks == 1 || m_workers.empty())
+	{
+		for (auto i = 0u; i < numTasks; ++i) func(i);
+		return;
+	}
+
+	lock_guard<mutex> submitLock(m_submitMutex);
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_pFunc = &func;
+		m_numTasks = numTasks;
+		m_nextTask = 0;
+		m_numActive = static_cast<uint32_t>(m_workers.size());
+		++m_generation;
+	}
+	m_workCV.notify_all();
+
+	// The caller works as well
+	runTasks();
+
+	unique_lock<mutex> lock(m_mutex);
+	m_doneCV.wait(lock, [this]() { return m_numActive == 0; });
+	m_pFunc = nullptr;
+}
+
+uint32_t ThreadPool::GetNumThreads() const
+{
+	return static_cast<uint32_t>(m_workers.size()) + 1;
+}
+
+void ThreadPool::workerLoop()
+{
+	uint64_t generation = 0;
+
+	while (true)
+	{
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_workCV.wait(lock, [&]() { return m_quit || m_generation != generation; });
+			if (m_quit) return;
+			generation = m_generation;
+		}
+
+		runTasks();
+
+		lock_guard<mutex> lock(m_mutex);
+		if (--m_numActive == 0) m_doneCV.notify_one();
+	}
+}
+
+void ThreadPool::runTasks()
+{
+	for (auto i = m_nextTask++; i < m_numTasks; i = m_nextTask++)
+		(*m_pFunc)(i);
+}
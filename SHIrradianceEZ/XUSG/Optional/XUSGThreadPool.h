@@ -0,0 +1,49 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace XUSG
+{
+	// Persistent workers for fork-join loops, so that short jobs do not pay for thread creation
+	class ThreadPool
+	{
+	public:
+		typedef std::function<void(uint32_t taskIdx)> TaskFunc;
+
+		// The calling thread counts as one of the numThreads, 0 for the hardware concurrency
+		ThreadPool(uint32_t numThreads = 0);
+		virtual ~ThreadPool();
+
+		// Runs func(0) ... func(numTasks - 1) and returns when all of them are done
+		void ParallelFor(uint32_t numTasks, const TaskFunc& func);
+
+		uint32_t GetNumThreads() const;
+
+	protected:
+		void workerLoop();
+		void runTasks();
+
+		std::vector<std::thread>	m_workers;
+
+		std::mutex					m_submitMutex;
+		std::mutex					m_mutex;
+		std::condition_variable		m_workCV;
+		std::condition_variable		m_doneCV;
+
+		const TaskFunc*				m_pFunc;
+		uint32_t					m_numTasks;
+		std::atomic<uint32_t>		m_nextTask;
+		uint32_t					m_numActive;
+		uint64_t					m_generation;
+		bool						m_quit;
+	};
+}
@@ -0,0 +1,128 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include "XUSGVertexQuantizer.h"
+
+using namespace std;
+using namespace XUSG;
+
+namespace
+{
+	inline uint32_t toUnorm(float v, uint32_t maxValue)
+	{
+		return static_cast<uint32_t>(lround((min)((max)(v, 0.0f), 1.0f) * maxValue));
+	}
+
+	inline uint32_t toSnorm16(float v)
+	{
+		return static_cast<uint16_t>(static_cast<int16_t>(lround((min)((max)(v, -1.0f), 1.0f) * 32767.0f)));
+	}
+
+	inline float fromSnorm16(uint32_t bits)
+	{
+		return (max)(static_cast<int16_t>(bits & 0xffff) / 32767.0f, -1.0f);
+	}
+
+	inline float signNotZero(float v)
+	{
+		return v >= 0.0f ? 1.0f : -1.0f;
+	}
+}
+
+VertexQuantizer::VertexQuantizer(NormalFormat normalFormat) :
+	m_dequant(),
+	m_normalFormat(normalFormat)
+{
+}
+
+VertexQuantizer::~VertexQuantizer()
+{
+}
+
+void VertexQuantizer::Quantize(vector<Vertex>& dst, const uint8_t* pVertices, uint32_t stride,
+	uint32_t numVertices, const float aabbMin[3], const float aabbMax[3])
+{
+	float invScale[3];
+	for (uint8_t i = 0; i < 3; ++i)
+	{
+		m_dequant.Scale[i] = aabbMax[i] - aabbMin[i];
+		m_dequant.Bias[i] = aabbMin[i];
+		invScale[i] = m_dequant.Scale[i] > 0.0f ? 1.0f / m_dequant.Scale[i] : 0.0f;
+	}
+
+	const auto hasNormal = stride >= sizeof(float[6]);
+	const float defaultNormal[] = { 0.0f, 0.0f, 1.0f };
+	dst.resize(numVertices);
+	for (auto i = 0u; i < numVertices; ++i)
+	{
+		const auto pPos = reinterpret_cast<const float*>(&pVertices[stride * i]);
+		auto& vertex = dst[i];
+		for (uint8_t j = 0; j < 3; ++j)
+			vertex.Pos[j] = static_cast<uint16_t>(toUnorm((pPos[j] - m_dequant.Bias[j]) * invScale[j], 0xffff));
+		vertex.Pos[3] = 0;
+		vertex.Nrm = EncodeNormal(hasNormal ? &pPos[3] : defaultNormal, m_normalFormat);
+	}
+}
+
+VertexQuantizer::NormalFormat VertexQuantizer::GetNormalFormat() const
+{
+	return m_normalFormat;
+}
+
+const VertexQuantizer::Dequantization& VertexQuantizer::GetDequantization() const
+{
+	return m_dequant;
+}
+
+uint32_t VertexQuantizer::EncodeNormal(const float n[3], NormalFormat normalFormat)
+{
+	if (normalFormat == NORMAL_R10G10B10A2)
+	{
+		uint32_t bits = 0;
+		for (uint8_t i = 0; i < 3; ++i) bits |= toUnorm(n[i] * 0.5f + 0.5f, 0x3ff) << (10 * i);
+
+		return bits;
+	}
+
+	// Project onto the octahedron, and fold the lower hemisphere
+	const auto l1 = fabs(n[0]) + fabs(n[1]) + fabs(n[2]);
+	auto x = l1 > 0.0f ? n[0] / l1 : 0.0f;
+	auto y = l1 > 0.0f ? n[1] / l1 : 0.0f;
+	if (n[2] < 0.0f)
+	{
+		const auto tx = (1.0f - fabs(y)) * signNotZero(x);
+		y = (1.0f - fabs(x)) * signNotZero(y);
+		x = tx;
+	}
+
+	return toSnorm16(x) | (toSnorm16(y) << 16);
+}
+
+void VertexQuantizer::DecodeNormal(float n[3], uint32_t bits, NormalFormat normalFormat)
+{
+	if (normalFormat == NORMAL_R10G10B10A2)
+	{
+		for (uint8_t i = 0; i < 3; ++i) n[i] = ((bits >> (10 * i)) & 0x3ff) / 1023.0f * 2.0f - 1.0f;
+	}
+	else
+	{
+		n[0] = fromSnorm16(bits);
+		n[1] = fromSnorm16(bits >> 16);
+		n[2] = 1.0f - fabs(n[0]) - fabs(n[1]);
+
+		const auto t = (max)(-n[2], 0.0f);
+		n[0] += n[0] >= 0.0f ? -t : t;
+		n[1] += n[1] >= 0.0f ? -t : t;
+	}
+
+	const auto l = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+	for (uint8_t i = 0; i < 3; ++i) n[i] = l > 0.0f ? n[i] / l : 0.0f;
+}
+
+void VertexQuantizer::DecodePosition(float pos[3], const uint16_t quantized[4], const Dequantization& dequant)
+{
+	for (uint8_t i = 0; i < 3; ++i) pos[i] = quantized[i] / 65535.0f * dequant.Scale[i] + dequant.Bias[i];
+}
@@ -0,0 +1,56 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace XUSG
+{
+	// Compresses float3 position + float3 normal vertices (24 bytes) to 12 bytes: 16-bit
+	// UNORM positions relative to the mesh AABB, and 32-bit packed normals
+	class VertexQuantizer
+	{
+	public:
+		enum NormalFormat : uint8_t
+		{
+			NORMAL_OCTAHEDRAL,	// Octahedral map in R16G16_SNORM
+			NORMAL_R10G10B10A2	// n * 0.5 + 0.5 in R10G10B10A2_UNORM
+		};
+
+		struct Vertex
+		{
+			uint16_t Pos[4];	// R16G16B16A16_UNORM, w is unused
+			uint32_t Nrm;		// Bits of the normal format, read as R32_UINT
+		};
+
+		// pos = unorm * Scale + Bias
+		struct Dequantization
+		{
+			float Scale[3];
+			float Bias[3];
+		};
+
+		VertexQuantizer(NormalFormat normalFormat = NORMAL_OCTAHEDRAL);
+		virtual ~VertexQuantizer();
+
+		// Positions are the first float3 of each vertex, followed by the normal if the
+		// stride is at least 24 bytes
+		void Quantize(std::vector<Vertex>& dst, const uint8_t* pVertices, uint32_t stride,
+			uint32_t numVertices, const float aabbMin[3], const float aabbMax[3]);
+
+		NormalFormat GetNormalFormat() const;
+		const Dequantization& GetDequantization() const;
+
+		static uint32_t EncodeNormal(const float n[3], NormalFormat normalFormat);
+		static void DecodeNormal(float n[3], uint32_t bits, NormalFormat normalFormat);
+		static void DecodePosition(float pos[3], const uint16_t quantized[4], const Dequantization& dequant);
+
+	protected:
+		Dequantization m_dequant;
+
+		NormalFormat m_normalFormat;
+	};
+}
@@ -13,6 +13,9 @@ cbuffer cb
 {
 	uint g_order;
 	uint g_mapSize;
+#ifdef _TILED_
+	uint g_groupOffset;
+#endif
 };
 
 //--------------------------------------------------------------------------------------
@@ -33,6 +36,12 @@ SamplerState g_sampler;
 [numthreads(SH_GROUP_SIZE, 1, 1)]
 void main(uint DTid : SV_DispatchThreadID, uint GTid : SV_GroupThreadID, uint Gid : SV_GroupID)
 {
+#ifdef _TILED_
+	// The dispatch only covers the groups from g_groupOffset on, e.g., of the dirty tiles
+	DTid += SH_GROUP_SIZE * g_groupOffset;
+	Gid += g_groupOffset;
+#endif
+
 	uint3 idx;
 	const uint sliceSize = g_mapSize * g_mapSize;
 	const uint xy = DTid % sliceSize;
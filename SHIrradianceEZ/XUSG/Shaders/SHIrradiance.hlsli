@@ -2,11 +2,18 @@
 // Copyright (c) XU, Tianchen. All rights reserved.
 //--------------------------------------------------------------------------------------
 
+#include "SHMath.hlsli"
+
 #ifndef PI
 #define PI 3.1415926535897
 #endif
 #define SH_NUM_COEFF (SH_ORDER * SH_ORDER)
 
+// Window of EvaluateSHIrradianceGeneric(), 0: none, 1: Hanning, 2: Lanczos
+#ifndef SH_WINDOW
+#define SH_WINDOW 0
+#endif
+
 //--------------------------------------------------------------------------------------
 // Load spherical harmonics
 //--------------------------------------------------------------------------------------
@@ -16,6 +23,24 @@ void LoadSH(out float3 shCoeffs[SH_NUM_COEFF], StructuredBuffer<float3> roSHCoef
 	for (uint i = 0; i < SH_NUM_COEFF; ++i) shCoeffs[i] = roSHCoeffs[i];
 }
 
+//--------------------------------------------------------------------------------------
+// Cosine-lobe factor A_l of band l, weighted by the window
+//--------------------------------------------------------------------------------------
+float GetSHIrradianceBandScale(uint l)
+{
+	const float lobes[SH_MAX_ORDER] = { PI, 2.0 * PI / 3.0, PI / 4.0, 0.0, -PI / 24.0, 0.0 };
+	const float x = PI * l / SH_ORDER;
+#if SH_WINDOW == 1
+	const float w = 0.5 * (1.0 + cos(x));
+#elif SH_WINDOW == 2
+	const float w = l > 0 ? sin(x) / x : 1.0;
+#else
+	const float w = 1.0;
+#endif
+
+	return lobes[l] * w;
+}
+
 //--------------------------------------------------------------------------------------
 // Evaluate irradiance using spherical harmonics
 //--------------------------------------------------------------------------------------
@@ -36,6 +36,30 @@ float4 EvaluateSHIrradiance(T SH_COEFFS, float3 norm)
 	return float4(irradiance, avgLum);
 }
 
+//--------------------------------------------------------------------------------------
+// SH irradiance evaluation of any SH_ORDER, matching XUSG::SH::SHEvalIrradiance() of
+// the SHConvolveIrradiance() coefficients with SH_WINDOW
+//--------------------------------------------------------------------------------------
+float4 EvaluateSHIrradianceGeneric(T SH_COEFFS, float3 norm)
+{
+	float basis[SH_MAX_COEFF];
+	SHEvalDirection(basis, SH_ORDER, norm);
+
+	float3 irradiance = 0.0;
+	[unroll]
+	for (uint l = 0; l < SH_ORDER; ++l)
+	{
+		float3 band = 0.0;
+		[unroll]
+		for (uint k = l * l; k < (l + 1) * (l + 1); ++k) band += shCoeffs[k] * basis[k];
+		irradiance += GetSHIrradianceBandScale(l) * band;
+	}
+
+	const float avgLum = dot(shCoeffs[0], float3(0.25, 0.5, 0.25));
+
+	return float4(max(irradiance, 0.0), avgLum);
+}
+
 //--------------------------------------------------------------------------------------
 // SH irradiance evaluation using tangent for hair
 //--------------------------------------------------------------------------------------